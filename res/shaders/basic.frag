@@ -1,9 +1,9 @@
 #version 330 core
 
+in vec4 rect_color;
 out vec4 color;
 
 void main()
 {
-	color = vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	color = rect_color;
 }
-
@@ -1,11 +1,13 @@
 #version 330 core
 
 layout (location = 0) in vec2 position;
+layout (location = 1) in vec4 rect;
+layout (location = 2) in vec4 color;
 uniform mat4 projection;
-uniform mat4 transformation;
+out vec4 rect_color;
 
 void main()
 {
-	gl_Position = projection * transformation * vec4(position, 0.0f, 1.0f);
+	gl_Position = projection * vec4(rect.xy + position * rect.zw, 0.0f, 1.0f);
+	rect_color = color;
 }
-
@@ -1,34 +1,440 @@
 #include "ball.h"
 #include "core.h"
+#ifndef PONG_HEADLESS
 #include "renderer.h"
+#include "triplebuffer.h"
+#endif
 #include "log.h"
+#include "error.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(PONG_BALL_STRESS) || defined(PONG_BALL_BENCHMARK)
+#include <time.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#define PONG_BALL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
 
-struct PongBall {
-	float xpos, ypos, xsize, ysize, xvel, yvel;
+#define PONG_BALL_STORE_INITIAL_CAPACITY 16
+
+#if defined(PONG_BALL_STRESS) && !defined(PONG_BALL_STRESS_COUNT)
+#define PONG_BALL_STRESS_COUNT 100000
+#endif
+
+#ifdef PONG_BALL_BENCHMARK
+#ifndef PONG_LOGGING
+#error PONG_BALL_BENCHMARK needs PONG_LOGGING to report its results!
+#endif
+#ifndef PONG_BALL_BENCHMARK_COUNT
+#define PONG_BALL_BENCHMARK_COUNT 100000
+#endif
+#define PONG_BALL_BENCHMARK_ITERATIONS 1000
+#endif
+
+// Balls are kept packed in structure-of-arrays form so updates stream through memory
+// Ball IDs map to a slot in the arrays, destroyed balls are swapped out with the last ball
+// Unused IDs form a free list threaded through id_slots
+// The previous tick's positions are kept so the renderer can interpolate between ticks
+struct PongBallStore {
+	float *xpos, *ypos, *xsize, *ysize, *xvel, *yvel;
+#ifndef PONG_HEADLESS
+	float *prev_xpos, *prev_ypos;
+#endif
+	unsigned int *slot_ids;
+	unsigned int *id_slots;
+	unsigned int free_id;
+	unsigned int count;
+	unsigned int capacity;
+};
+
+// Moves every position along by its velocity, flipping any position past bound to the other side
+// Every kernel must give bit-identical results to the scalar one
+typedef void (*PongBallIntegrateKernel)(float *pos, const float *vel, unsigned int count, float bound);
+
+struct PongBallKernel {
+	const char *name;
+	PongBallIntegrateKernel integrate;
+	unsigned int is_supported;
+};
+
+#ifndef PONG_HEADLESS
+// Copy of what's needed to draw the balls, passed from the simulation thread to the render thread
+struct PongBallSnapshot {
+	float *prev_xpos, *prev_ypos, *xpos, *ypos, *xsize, *ysize;
+	unsigned long long tick_nsec;
+	unsigned int count;
+	unsigned int capacity;
+};
+#endif
+
+#ifdef PONG_BALL_STRESS
+struct PongBallTimings {
+	const char *label;
+	unsigned long long total_nsec, max_nsec, last_report_nsec;
+	unsigned int samples;
 };
+#endif
+
+static void pong_ball_internal_setCapacity(unsigned int new_capacity);
+static void pong_ball_internal_integrateScalar(float *pos, const float *vel, unsigned int count, float bound);
+#ifdef PONG_BALL_X86_KERNELS
+static void pong_ball_internal_integrateSse2(float *pos, const float *vel, unsigned int count, float bound);
+static void pong_ball_internal_integrateAvx2(float *pos, const float *vel, unsigned int count, float bound);
+#endif
+#ifdef PONG_BALL_BENCHMARK
+static void pong_ball_internal_runBenchmark(void);
+#endif
+#if defined(PONG_BALL_STRESS) || defined(PONG_BALL_BENCHMARK)
+static unsigned long long pong_ball_internal_getNsec(void);
+#endif
+#ifdef PONG_BALL_STRESS
+static void pong_ball_internal_recordTiming(struct PongBallTimings *timings, unsigned long long start_nsec);
+#endif
+
+static struct PongBallStore balls;
+#ifndef PONG_HEADLESS
+static struct PongBallSnapshot snapshots[3];
+static struct PongTripleBuffer snapshot_buffer;
+static const struct PongBallSnapshot *drawn_snapshot = snapshots + 2;
+#endif
+static PongBallIntegrateKernel integrate_kernel = pong_ball_internal_integrateScalar;
+static struct PongBallKernel kernels[] = {
+	{ "scalar", pong_ball_internal_integrateScalar, 1 },
+#ifdef PONG_BALL_X86_KERNELS
+	{ "SSE2", pong_ball_internal_integrateSse2, 0 },
+	{ "AVX2", pong_ball_internal_integrateAvx2, 0 },
+#endif
+};
+#ifdef PONG_BALL_STRESS
+static struct PongBallTimings update_timings = { "update", 0 };
+#ifndef PONG_HEADLESS
+static struct PongBallTimings draw_timings = { "draw", 0 };
+#endif
+#endif
+
+void pong_ball_init(void) {
+	PONG_LOG_SUBGROUP_START("Balls");
+	PONG_LOG("Initializing ball store...", PONG_LOG_INFO);
+	balls.free_id = PONG_BALL_INVALID_ID;
+	pong_ball_internal_setCapacity(PONG_BALL_STORE_INITIAL_CAPACITY);
+#ifndef PONG_HEADLESS
+	pong_triplebuffer_init(&snapshot_buffer);
+#endif
+
+#ifdef PONG_BALL_X86_KERNELS
+	__builtin_cpu_init();
+	kernels[1].is_supported = __builtin_cpu_supports("sse2");
+	kernels[2].is_supported = __builtin_cpu_supports("avx2");
+#endif
+	for (unsigned int i = 0; i < sizeof kernels / sizeof *kernels; i++)
+		if (kernels[i].is_supported)
+			integrate_kernel = kernels[i].integrate;
+	for (unsigned int i = 0; i < sizeof kernels / sizeof *kernels; i++)
+		if (kernels[i].integrate == integrate_kernel)
+			PONG_LOG("Using %s ball integration kernel.", PONG_LOG_INFO, kernels[i].name);
+#ifdef PONG_BALL_BENCHMARK
+	pong_ball_internal_runBenchmark();
+#endif
+#ifdef PONG_BALL_STRESS
+	PONG_LOG("Spawning %u balls for stress test...", PONG_LOG_NOTEWORTHY, PONG_BALL_STRESS_COUNT);
+	srand(1);
+	for (unsigned int i = 0; i < PONG_BALL_STRESS_COUNT; i++) {
+		unsigned int ball_id = pong_ball_create();
+		unsigned int slot = balls.id_slots[ball_id];
+		balls.xpos[slot] = ((float) rand() / RAND_MAX - 0.5f) * PONG_WINDOW_WIDTH;
+		balls.ypos[slot] = ((float) rand() / RAND_MAX - 0.5f) * PONG_WINDOW_HEIGHT;
+		balls.xvel[slot] = 0.5f + 3.5f * rand() / RAND_MAX;
+		balls.yvel[slot] = 0.5f + 3.5f * rand() / RAND_MAX;
+	}
+	update_timings.last_report_nsec = pong_ball_internal_getNsec();
+#ifndef PONG_HEADLESS
+	draw_timings.last_report_nsec = update_timings.last_report_nsec;
+#endif
+#endif
+	PONG_LOG_SUBGROUP_END();
+}
+
+unsigned int pong_ball_create(void) {
+	if (balls.count == balls.capacity)
+		pong_ball_internal_setCapacity(balls.capacity * 2);
+
+	unsigned int ball_id;
+	if (balls.free_id != PONG_BALL_INVALID_ID) {
+		ball_id = balls.free_id;
+		balls.free_id = balls.id_slots[ball_id];
+	} else {
+		ball_id = balls.count; // no free IDs means every ID below count is in use
+	}
+
+	unsigned int slot = balls.count++;
+	balls.xpos[slot] = 0.f;
+	balls.ypos[slot] = 0.f;
+#ifndef PONG_HEADLESS
+	balls.prev_xpos[slot] = balls.xpos[slot];
+	balls.prev_ypos[slot] = balls.ypos[slot];
+#endif
+	balls.xsize[slot] = 10.f;
+	balls.ysize[slot] = 10.f;
+	balls.xvel[slot] = 1.f;
+	balls.yvel[slot] = 2.f;
+	balls.slot_ids[slot] = ball_id;
+	balls.id_slots[ball_id] = slot;
+	return ball_id;
+}
 
-struct PongBall *pong_ball_create() {
-	PONG_LOG("Creating new ball...", PONG_LOG_VERBOSE);
-	struct PongBall *ball = malloc(sizeof (struct PongBall));
-	*ball = (struct PongBall) { 0.f, 0.f, 10.f, 10.f, 1.f, 2.f };
-	PONG_LOG("Initialized ball at %p!", PONG_LOG_VERBOSE, ball);
-	return ball;
+void pong_ball_update(void) {
+	PONG_PROFILE_ZONE_START("BallUpdate");
+#ifdef PONG_BALL_STRESS
+	unsigned long long start_nsec = pong_ball_internal_getNsec();
+#endif
+#ifndef PONG_HEADLESS
+	memcpy(balls.prev_xpos, balls.xpos, sizeof (float) * balls.count);
+	memcpy(balls.prev_ypos, balls.ypos, sizeof (float) * balls.count);
+#endif
+	integrate_kernel(balls.xpos, balls.xvel, balls.count, PONG_WINDOW_WIDTH / 2.f);
+	integrate_kernel(balls.ypos, balls.yvel, balls.count, PONG_WINDOW_HEIGHT / 2.f);
+#ifdef PONG_BALL_STRESS
+	pong_ball_internal_recordTiming(&update_timings, start_nsec);
+#endif
+	PONG_PROFILE_ZONE_END();
 }
 
-void pong_ball_update(struct PongBall *ball) {
-	ball->xpos += ball->xvel;
-	ball->ypos += ball->yvel;
-	if (ball->xpos > PONG_WINDOW_WIDTH / 2.f) ball->xpos = -ball->xpos;
-	if (ball->ypos > PONG_WINDOW_HEIGHT / 2.f) ball->ypos = -ball->ypos;
+#ifndef PONG_HEADLESS
+// Called on the simulation thread after each tick, tick_nsec being when the tick was due
+void pong_ball_publishSnapshot(unsigned long long tick_nsec) {
+	struct PongBallSnapshot *snapshot = snapshots + pong_triplebuffer_getWriteIndex(&snapshot_buffer);
+	if (snapshot->capacity < balls.count) {
+		float **snapshot_arrays[] = { &snapshot->prev_xpos, &snapshot->prev_ypos, &snapshot->xpos, &snapshot->ypos, &snapshot->xsize, &snapshot->ysize };
+		for (unsigned int i = 0; i < sizeof snapshot_arrays / sizeof *snapshot_arrays; i++) {
+			float *new_array = realloc(*snapshot_arrays[i], sizeof (float) * balls.capacity);
+			if (!new_array)
+				PONG_ERROR("Could not reallocate memory for ball snapshot!");
+			*snapshot_arrays[i] = new_array;
+		}
+		snapshot->capacity = balls.capacity;
+	}
+	memcpy(snapshot->prev_xpos, balls.prev_xpos, sizeof (float) * balls.count);
+	memcpy(snapshot->prev_ypos, balls.prev_ypos, sizeof (float) * balls.count);
+	memcpy(snapshot->xpos, balls.xpos, sizeof (float) * balls.count);
+	memcpy(snapshot->ypos, balls.ypos, sizeof (float) * balls.count);
+	memcpy(snapshot->xsize, balls.xsize, sizeof (float) * balls.count);
+	memcpy(snapshot->ysize, balls.ysize, sizeof (float) * balls.count);
+	snapshot->count = balls.count;
+	snapshot->tick_nsec = tick_nsec;
+	pong_triplebuffer_publish(&snapshot_buffer);
 }
 
-void pong_ball_draw(struct PongBall *ball) {
-	pong_renderer_drawrect(ball->xpos, ball->ypos, ball->xsize, ball->ysize);
+// Called on the render thread to pick up the latest snapshot, returns when its tick was due
+unsigned long long pong_ball_acquireSnapshot(void) {
+	drawn_snapshot = snapshots + pong_triplebuffer_acquire(&snapshot_buffer);
+	return drawn_snapshot->tick_nsec;
 }
 
-void pong_ball_destroy(struct PongBall *ball) {
-	PONG_LOG("Destroying ball at %p...", PONG_LOG_VERBOSE, ball);
-	free(ball);
+// Called on the render thread, draws the acquired snapshot alpha of the way from its previous tick
+void pong_ball_draw(float alpha) {
+	PONG_PROFILE_ZONE_START("BallDraw");
+#ifdef PONG_BALL_STRESS
+	unsigned long long start_nsec = pong_ball_internal_getNsec();
+#endif
+	const struct PongBallSnapshot *snapshot = drawn_snapshot;
+	for (unsigned int i = 0; i < snapshot->count; i++) {
+		float xpos = snapshot->xpos[i], ypos = snapshot->ypos[i];
+		float xdelta = xpos - snapshot->prev_xpos[i], ydelta = ypos - snapshot->prev_ypos[i];
+		// A ball that wrapped to the other side jumps further than half the field, don't sweep it across the screen
+		if (fabsf(xdelta) < PONG_WINDOW_WIDTH / 2.f)
+			xpos -= xdelta * (1.f - alpha);
+		if (fabsf(ydelta) < PONG_WINDOW_HEIGHT / 2.f)
+			ypos -= ydelta * (1.f - alpha);
+		pong_renderer_drawrect(xpos, ypos, snapshot->xsize[i], snapshot->ysize[i]);
+	}
+#ifdef PONG_BALL_STRESS
+	pong_ball_internal_recordTiming(&draw_timings, start_nsec);
+#endif
+	PONG_PROFILE_ZONE_END();
 }
+#endif
 
+void pong_ball_destroy(unsigned int ball_id) {
+	PONG_LOG("Destroying ball %u...", PONG_LOG_VERBOSE, ball_id);
+	unsigned int slot = balls.id_slots[ball_id];
+	unsigned int last_slot = --balls.count;
+	if (slot != last_slot) {
+		balls.xpos[slot] = balls.xpos[last_slot];
+		balls.ypos[slot] = balls.ypos[last_slot];
+#ifndef PONG_HEADLESS
+		balls.prev_xpos[slot] = balls.prev_xpos[last_slot];
+		balls.prev_ypos[slot] = balls.prev_ypos[last_slot];
+#endif
+		balls.xsize[slot] = balls.xsize[last_slot];
+		balls.ysize[slot] = balls.ysize[last_slot];
+		balls.xvel[slot] = balls.xvel[last_slot];
+		balls.yvel[slot] = balls.yvel[last_slot];
+		balls.slot_ids[slot] = balls.slot_ids[last_slot];
+		balls.id_slots[balls.slot_ids[slot]] = slot;
+	}
+	balls.id_slots[ball_id] = balls.free_id;
+	balls.free_id = ball_id;
+}
+
+void pong_ball_cleanup(void) {
+	PONG_LOG_SUBGROUP_START("Balls");
+	PONG_LOG("Cleaning up ball store (%u balls remaining)...", PONG_LOG_INFO, balls.count);
+	free(balls.xpos);
+	free(balls.ypos);
+	free(balls.xsize);
+	free(balls.ysize);
+	free(balls.xvel);
+	free(balls.yvel);
+#ifndef PONG_HEADLESS
+	free(balls.prev_xpos);
+	free(balls.prev_ypos);
+#endif
+	free(balls.slot_ids);
+	free(balls.id_slots);
+	balls = (struct PongBallStore) { 0 };
+#ifndef PONG_HEADLESS
+	for (unsigned int i = 0; i < 3; i++) {
+		free(snapshots[i].prev_xpos);
+		free(snapshots[i].prev_ypos);
+		free(snapshots[i].xpos);
+		free(snapshots[i].ypos);
+		free(snapshots[i].xsize);
+		free(snapshots[i].ysize);
+		snapshots[i] = (struct PongBallSnapshot) { 0 };
+	}
+#endif
+	PONG_LOG_SUBGROUP_END();
+}
+
+static void pong_ball_internal_setCapacity(unsigned int new_capacity) {
+	PONG_LOG("Resizing ball store from %u to %u balls...", PONG_LOG_VERBOSE, balls.capacity, new_capacity);
+	float **float_arrays[] = {
+		&balls.xpos, &balls.ypos, &balls.xsize, &balls.ysize, &balls.xvel, &balls.yvel,
+#ifndef PONG_HEADLESS
+		&balls.prev_xpos, &balls.prev_ypos,
+#endif
+	};
+	for (unsigned int i = 0; i < sizeof float_arrays / sizeof *float_arrays; i++) {
+		float *new_array = realloc(*float_arrays[i], sizeof (float) * new_capacity);
+		if (!new_array)
+			PONG_ERROR("Could not reallocate memory for ball store!");
+		*float_arrays[i] = new_array;
+	}
+	unsigned int **index_arrays[] = { &balls.slot_ids, &balls.id_slots };
+	for (unsigned int i = 0; i < sizeof index_arrays / sizeof *index_arrays; i++) {
+		unsigned int *new_array = realloc(*index_arrays[i], sizeof (unsigned int) * new_capacity);
+		if (!new_array)
+			PONG_ERROR("Could not reallocate memory for ball store!");
+		*index_arrays[i] = new_array;
+	}
+	balls.capacity = new_capacity;
+}
+
+static void pong_ball_internal_integrateScalar(float *pos, const float *vel, unsigned int count, float bound) {
+	for (unsigned int i = 0; i < count; i++) {
+		pos[i] += vel[i];
+		if (pos[i] > bound) pos[i] = -pos[i];
+	}
+}
+
+#ifdef PONG_BALL_X86_KERNELS
+// Negating by flipping the sign bit is exactly what the scalar kernel's negation does
+__attribute__((target("sse2")))
+static void pong_ball_internal_integrateSse2(float *pos, const float *vel, unsigned int count, float bound) {
+	const __m128 bounds = _mm_set1_ps(bound);
+	const __m128 sign_bits = _mm_set1_ps(-0.f);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 new_pos = _mm_add_ps(_mm_loadu_ps(pos + i), _mm_loadu_ps(vel + i));
+		__m128 flips = _mm_and_ps(_mm_cmpgt_ps(new_pos, bounds), sign_bits);
+		_mm_storeu_ps(pos + i, _mm_xor_ps(new_pos, flips));
+	}
+	pong_ball_internal_integrateScalar(pos + i, vel + i, count - i, bound);
+}
+
+__attribute__((target("avx2")))
+static void pong_ball_internal_integrateAvx2(float *pos, const float *vel, unsigned int count, float bound) {
+	const __m256 bounds = _mm256_set1_ps(bound);
+	const __m256 sign_bits = _mm256_set1_ps(-0.f);
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 new_pos = _mm256_add_ps(_mm256_loadu_ps(pos + i), _mm256_loadu_ps(vel + i));
+		__m256 flips = _mm256_and_ps(_mm256_cmp_ps(new_pos, bounds, _CMP_GT_OQ), sign_bits);
+		_mm256_storeu_ps(pos + i, _mm256_xor_ps(new_pos, flips));
+	}
+	pong_ball_internal_integrateScalar(pos + i, vel + i, count - i, bound);
+}
+#endif
+
+#ifdef PONG_BALL_BENCHMARK
+// Times every supported kernel over the same data and checks they match the scalar kernel bit for bit
+static void pong_ball_internal_runBenchmark(void) {
+	PONG_LOG_SUBGROUP_START("Benchmark");
+	PONG_LOG("Benchmarking ball integration kernels over %u balls...", PONG_LOG_NOTEWORTHY, PONG_BALL_BENCHMARK_COUNT);
+	float *start_pos = malloc(sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+	float *vel = malloc(sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+	float *scalar_pos = malloc(sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+	float *pos = malloc(sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+	if (!start_pos || !vel || !scalar_pos || !pos)
+		PONG_ERROR("Could not allocate memory for ball benchmark!");
+	srand(1);
+	for (unsigned int i = 0; i < PONG_BALL_BENCHMARK_COUNT; i++) {
+		start_pos[i] = ((float) rand() / RAND_MAX - 0.5f) * PONG_WINDOW_WIDTH;
+		vel[i] = 0.5f + 3.5f * rand() / RAND_MAX;
+	}
+
+	for (unsigned int k = 0; k < sizeof kernels / sizeof *kernels; k++) {
+		if (!kernels[k].is_supported) {
+			PONG_LOG("%s: not supported by this CPU", PONG_LOG_INFO, kernels[k].name);
+			continue;
+		}
+		memcpy(pos, start_pos, sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+		unsigned long long start_nsec = pong_ball_internal_getNsec();
+		for (unsigned int i = 0; i < PONG_BALL_BENCHMARK_ITERATIONS; i++)
+			kernels[k].integrate(pos, vel, PONG_BALL_BENCHMARK_COUNT, PONG_WINDOW_WIDTH / 2.f);
+		unsigned long long elapsed_nsec = pong_ball_internal_getNsec() - start_nsec;
+		if (k == 0)
+			memcpy(scalar_pos, pos, sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+		unsigned int is_identical = !memcmp(pos, scalar_pos, sizeof (float) * PONG_BALL_BENCHMARK_COUNT);
+		PONG_LOG("%s: %.3fms per update, %.3fns per ball%s", is_identical ? PONG_LOG_INFO : PONG_LOG_ERROR, kernels[k].name,
+			elapsed_nsec / 1e6 / PONG_BALL_BENCHMARK_ITERATIONS, (double) elapsed_nsec / PONG_BALL_BENCHMARK_ITERATIONS / PONG_BALL_BENCHMARK_COUNT,
+			is_identical ? "" : " (DOES NOT MATCH SCALAR RESULTS)");
+	}
+
+	free(start_pos);
+	free(vel);
+	free(scalar_pos);
+	free(pos);
+	PONG_LOG_SUBGROUP_END();
+}
+#endif
+
+#if defined(PONG_BALL_STRESS) || defined(PONG_BALL_BENCHMARK)
+static unsigned long long pong_ball_internal_getNsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long) now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+#endif
+
+#ifdef PONG_BALL_STRESS
+// Logs the average and worst times roughly once a second, then resets them
+static void pong_ball_internal_recordTiming(struct PongBallTimings *timings, unsigned long long start_nsec) {
+	unsigned long long now_nsec = pong_ball_internal_getNsec();
+	unsigned long long elapsed_nsec = now_nsec - start_nsec;
+	timings->total_nsec += elapsed_nsec;
+	if (elapsed_nsec > timings->max_nsec)
+		timings->max_nsec = elapsed_nsec;
+	timings->samples++;
+
+	if (now_nsec - timings->last_report_nsec < NSEC_PER_SEC)
+		return;
+	PONG_LOG("Ball %s: avg %.3fms max %.3fms (%u samples)", PONG_LOG_INFO, timings->label,
+		timings->total_nsec / 1e6 / timings->samples, timings->max_nsec / 1e6, timings->samples);
+	timings->total_nsec = timings->max_nsec = 0;
+	timings->samples = 0;
+	timings->last_report_nsec = now_nsec;
+}
+#endif
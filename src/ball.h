@@ -1,12 +1,17 @@
 #ifndef PONG_BALL_H
 #define PONG_BALL_H
 
-struct PongBall;
+#define PONG_BALL_INVALID_ID 0xffffffffu
 
-struct PongBall *pong_ball_create();
-void pong_ball_update(struct PongBall *ball);
-void pong_ball_draw(struct PongBall *ball);
-void pong_ball_destroy(struct PongBall *ball);
+void pong_ball_init(void);
+unsigned int pong_ball_create(void);
+void pong_ball_update(void);
+#ifndef PONG_HEADLESS
+void pong_ball_publishSnapshot(unsigned long long tick_nsec);
+unsigned long long pong_ball_acquireSnapshot(void);
+void pong_ball_draw(float alpha);
+#endif
+void pong_ball_destroy(unsigned int ball_id);
+void pong_ball_cleanup(void);
 
 #endif // PONG_BALL_H
-
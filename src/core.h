@@ -25,4 +25,9 @@
 
 #define NSEC_PER_SEC 1000000000
 
+// Ball velocities are per tick, so changing this also changes game speed
+#ifndef PONG_TICKS_PER_SECOND
+#define PONG_TICKS_PER_SECOND 60
+#endif
+
 #endif // PONG_CORE_H
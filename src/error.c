@@ -3,16 +3,38 @@
 #include "log.h"
 #include <stdlib.h>
 #include <stdarg.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-void pong_error_internal_error(const char *message, ...) {
+static pthread_t main_thread;
+static atomic_uint has_thread_failed;
+
+// Must be called from the main thread, which is the only one allowed to clean up
+void pong_error_init(void) {
+	main_thread = pthread_self();
+}
+
+// Returns 1 if a thread other than the main one ran into an error and stopped
+unsigned int pong_error_hasThreadFailed(void) {
+	return atomic_load(&has_thread_failed);
+}
+
+_Noreturn void pong_error_internal_error(const char *message, ...) {
 	va_list args;
 	va_start(args, message);
 	PONG_LOG_VARIADIC(message, PONG_LOG_ERROR, args);
 	va_end(args);
 	PONG_LOG_CLEAR_SUBGROUPS();
+
+	// Cleaning up here would tear everything down from under the main thread, so it's left to stop the game and clean up
+	if (!pthread_equal(pthread_self(), main_thread)) {
+		atomic_store(&has_thread_failed, 1);
+		pong_stop();
+		pthread_exit(NULL);
+	}
+
 	PONG_LOG_SUBGROUP_START("ERROR");
 	pong_cleanup();
 	PONG_LOG_CLEANUP();
 	exit(1);
 }
-
@@ -7,7 +7,12 @@
 #define PONG_ERROR(...) pong_error_internal_error(NULL)
 #endif
 
-void pong_error_internal_error(const char *message, ...);
+void pong_error_init(void);
+unsigned int pong_error_hasThreadFailed(void);
+
+// Logs the error, cleans up and exits, so code after PONG_ERROR() is never reached
+// Other threads only stop themselves and the game, the main thread cleans up and exits once it notices
+_Noreturn void pong_error_internal_error(const char *message, ...);
 
 #endif // PONG_ERROR_H
 
@@ -1,21 +1,88 @@
 #include "events.h"
+#include "timing.h"
 #include "log.h"
 #include "error.h"
+#if defined(PONG_EVENTS_RECORD) || defined(PONG_EVENTS_REPLAY)
+#include "files.h"
+#include <stdio.h>
+#endif
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-// TODO: each event is as large as the largest event, use pointers to structs?
-union PongEventArguments {
-	struct { int is_focused; } window_focus_event;
+#define PONG_EVENTS_ARENA_SIZE 16384 // bytes per producer and priority, must be a power of two
+#define PONG_EVENTS_MAX_PAYLOAD_SIZE (PONG_EVENTS_ARENA_SIZE / 4)
+#define PONG_EVENTS_RECORD_ALIGNMENT 8
+#define PONG_EVENTS_CACHE_LINE_SIZE 64
+#define PONG_EVENTS_TIMER_WHEEL_BITS 8
+#define PONG_EVENTS_TIMER_WHEEL_SIZE (1u << PONG_EVENTS_TIMER_WHEEL_BITS)
+#define PONG_EVENTS_TIMER_WHEEL_LEVELS 4 // enough to cover any unsigned int delay
+#define PONG_EVENTS_TIMER_INITIAL_CAPACITY 64
+
+// Recordings are a magic number and version, then one record per event handled, all integers little-endian
+// Each record is the tick it was handled on (4 bytes), its type and payload size (2 bytes each), then the payload
+#if defined(PONG_EVENTS_RECORD) && defined(PONG_EVENTS_REPLAY)
+#error PONG_EVENTS_RECORD and PONG_EVENTS_REPLAY cannot be used together!
+#endif
+#ifndef PONG_EVENTS_RECORDING_FILE
+#define PONG_EVENTS_RECORDING_FILE "events.rec"
+#endif
+#define PONG_EVENTS_RECORDING_MAGIC 0x43455250u // "PREC"
+#define PONG_EVENTS_RECORDING_VERSION 1
+#define PONG_EVENTS_RECORDING_HEADER_SIZE 8
+#define PONG_EVENTS_RECORD_HEADER_SIZE 8
+
+// Every event is a header followed by its payload, padded to PONG_EVENTS_RECORD_ALIGNMENT so the next header lines up
+// nsec is when the event was pushed from pong_timing_getNsec(), a type of PongEventTypeCount marks the unused end of an arena
+struct PongEventHeader {
+	unsigned long long nsec;
+	unsigned int type;
+	unsigned int size;
 };
 
-struct PongEvent {
-	enum PongEventType type;
-	union PongEventArguments arguments;
+// Single-producer ring of bytes that events are bumped onto back-to-back, a record that won't fit before the end skips to the start
+// tail is only written by the producer, read and head by the polling thread, all free-running so tail - head is the bytes in use
+// head only catches up with read once a poll is done, so every payload stays put until its poll returns
+struct PongEventArena {
+	unsigned char bytes[PONG_EVENTS_ARENA_SIZE];
+	_Alignas(PONG_EVENTS_CACHE_LINE_SIZE) atomic_uint head;
+	unsigned int read;
+	_Alignas(PONG_EVENTS_CACHE_LINE_SIZE) atomic_uint tail;
 };
 
-struct PongEventArray {
-	struct PongEvent **events;
-	unsigned int length;
+// Every thread that pushes events gets its own arena per priority, so pushing never waits on a lock or retries
+// Stats are only written by the producer, so they're bumped with plain loads and stores
+struct PongEventProducer {
+	struct PongEventArena arenas[PongEventPriorityCount];
+	_Alignas(PONG_EVENTS_CACHE_LINE_SIZE) atomic_ulong pushed_count;
+	atomic_ulong dropped_count;
+	atomic_uint max_depth;
+	_Alignas(PONG_EVENTS_CACHE_LINE_SIZE) _Atomic(const char *) name;
+	struct PongEventProducer *next;
+};
+
+// Timers are linked into their wheel slot by ID rather than pointer, so the array can grow without fixing up links
+// slot is PONG_EVENTS_INVALID_TIMER_ID while a timer isn't pending, unused IDs form a free list threaded through next
+struct PongEventTimer {
+	unsigned long long due_tick;
+	unsigned int period_ticks;
+	unsigned int slot;
+	unsigned int prev, next;
+};
+
+// Hierarchical timing wheel, ticking once per poll
+// Level n buckets timers due within PONG_EVENTS_TIMER_WHEEL_SIZE^(n+1) ticks by the nth digit of their due tick
+// Whenever the digits below a level wrap around, its current slot is due soon enough to be spread over the levels below it
+// Every ID below used_count has been handed out at some point, so with no free IDs the next one is used_count
+struct PongEventTimerWheel {
+	struct PongEventTimer *timers;
+	unsigned int capacity;
+	unsigned int used_count;
+	unsigned int pending_count;
+	unsigned int free_id;
+	unsigned long long tick;
+	unsigned int slots[PONG_EVENTS_TIMER_WHEEL_LEVELS * PONG_EVENTS_TIMER_WHEEL_SIZE];
 };
 
 struct PongEventCallbackArray {
@@ -23,20 +90,117 @@ struct PongEventCallbackArray {
 	unsigned int length;
 };
 
-static void pong_events_internal_pushEvent(struct PongEvent event);
-static unsigned int pong_events_internal_executeCallback(PongEventCallback callback, enum PongEventType event_type, union PongEventArguments event_args);
+static void pong_events_internal_pushEvent(enum PongEventType event_type, const void *payload, unsigned int payload_size);
+static struct PongEventProducer *pong_events_internal_getThreadProducer(void);
+static struct PongEventArena *pong_events_internal_findOldestEvent(struct PongEventProducer *producers, unsigned long long deadline_nsec, struct PongEventHeader *header, const unsigned char **payload);
+static const unsigned char *pong_events_internal_peekEvent(struct PongEventArena *arena, struct PongEventHeader *header);
+static unsigned int pong_events_internal_getRecordSize(unsigned int payload_size);
+static void pong_events_internal_dispatchEvent(const struct PongEventHeader *header, const void *payload);
+static unsigned int pong_events_internal_executeCallback(PongEventCallback callback, enum PongEventType event_type, const void *payload);
+static void pong_events_internal_advanceTimers(void);
+static void pong_events_internal_insertTimer(unsigned int timer_id, unsigned long long due_tick);
+static void pong_events_internal_unlinkTimer(unsigned int timer_id);
+static void pong_events_internal_freeTimer(unsigned int timer_id);
+#if defined(PONG_EVENTS_RECORD) || defined(PONG_EVENTS_REPLAY)
+static char *pong_events_internal_getRecordingFilePath(void);
+#endif
+#ifdef PONG_EVENTS_RECORD
+static void pong_events_internal_recordEvent(const struct PongEventHeader *header, const void *payload);
+#endif
+#ifdef PONG_EVENTS_REPLAY
+static void pong_events_internal_replayTick(void);
+static unsigned int pong_events_internal_readU32(const unsigned char *bytes);
+#endif
 
-static struct PongEventArray event_queue;
+// Producers are only ever added to the front of the list until cleanup, so the polling thread can walk it without locking
+// The mutex only serialises threads registering on their first push
+static _Thread_local struct PongEventProducer *thread_producer;
+static _Atomic(struct PongEventProducer *) event_producers;
+static pthread_mutex_t event_producers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int are_producers_finished;
 static struct PongEventCallbackArray events_callbacks[PongEventTypeCount];
+static const enum PongEventPriority event_priorities[PongEventTypeCount] = {
+	[PONG_EVENT_FOCUS] = PONG_EVENT_PRIORITY_NORMAL,
+	[PONG_EVENT_QUIT] = PONG_EVENT_PRIORITY_HIGH,
+	[PONG_EVENT_TIMER] = PONG_EVENT_PRIORITY_NORMAL
+};
+#ifdef PONG_EVENTS_REPLAY
+// Only input is replaced by a replay, other events like quitting still get through so a replay can be stopped
+static const unsigned int event_is_input[PongEventTypeCount] = {
+	[PONG_EVENT_FOCUS] = 1
+};
+#endif
+static unsigned long long dispatching_event_nsec;
+static unsigned long event_tick; // events are polled once per tick
+static struct PongEventTimerWheel timer_wheel;
+#ifdef PONG_EVENTS_RECORD
+static FILE *recording_file;
+#endif
+#ifdef PONG_EVENTS_REPLAY
+static const unsigned char *replay_data;
+static size_t replay_size;
+static size_t replay_offset;
+static atomic_uint is_replaying;
+#endif
 
+// Recordings are written to and replayed from PONG_EVENTS_RECORDING_FILE in the data directory
+void pong_events_init(void) {
+	PONG_LOG_SUBGROUP_START("Events");
+	PONG_LOG("Initializing events...", PONG_LOG_INFO);
+	event_tick = 0;
+	PONG_LOG("Creating timer wheel...", PONG_LOG_VERBOSE);
+	timer_wheel.timers = malloc(sizeof (struct PongEventTimer) * PONG_EVENTS_TIMER_INITIAL_CAPACITY);
+	if (!timer_wheel.timers)
+		PONG_ERROR("Could not allocate memory for event timers!");
+	timer_wheel.capacity = PONG_EVENTS_TIMER_INITIAL_CAPACITY;
+	timer_wheel.used_count = timer_wheel.pending_count = 0;
+	timer_wheel.free_id = PONG_EVENTS_INVALID_TIMER_ID;
+	timer_wheel.tick = 0;
+	for (unsigned int i = 0; i < PONG_EVENTS_TIMER_WHEEL_LEVELS * PONG_EVENTS_TIMER_WHEEL_SIZE; i++)
+		timer_wheel.slots[i] = PONG_EVENTS_INVALID_TIMER_ID;
+#ifdef PONG_EVENTS_RECORD
+	char *recording_file_path = pong_events_internal_getRecordingFilePath();
+	PONG_LOG("Recording events to '%s'...", PONG_LOG_NOTEWORTHY, recording_file_path);
+	recording_file = fopen(recording_file_path, "wb");
+	free(recording_file_path);
+	if (!recording_file)
+		PONG_ERROR("Could not open event recording for writing!");
+	unsigned char recording_header[PONG_EVENTS_RECORDING_HEADER_SIZE];
+	for (unsigned int i = 0; i < 4; i++) {
+		recording_header[i] = PONG_EVENTS_RECORDING_MAGIC >> (i * 8);
+		recording_header[i + 4] = PONG_EVENTS_RECORDING_VERSION >> (i * 8);
+	}
+	fwrite(recording_header, 1, PONG_EVENTS_RECORDING_HEADER_SIZE, recording_file);
+#endif
+#ifdef PONG_EVENTS_REPLAY
+	char *replay_file_path = pong_events_internal_getRecordingFilePath();
+	PONG_LOG("Replaying events from '%s'...", PONG_LOG_NOTEWORTHY, replay_file_path);
+	replay_data = pong_files_mapFile(replay_file_path, &replay_size);
+	free(replay_file_path);
+	if (replay_size < PONG_EVENTS_RECORDING_HEADER_SIZE || pong_events_internal_readU32(replay_data) != PONG_EVENTS_RECORDING_MAGIC)
+		PONG_ERROR("Event recording is not an event recording!");
+	if (pong_events_internal_readU32(replay_data + 4) != PONG_EVENTS_RECORDING_VERSION)
+		PONG_ERROR("Event recording is version %u, but version %u is required!", pong_events_internal_readU32(replay_data + 4), PONG_EVENTS_RECORDING_VERSION);
+	replay_offset = PONG_EVENTS_RECORDING_HEADER_SIZE;
+	atomic_store(&is_replaying, 1);
+#endif
+	PONG_LOG_SUBGROUP_END();
+}
+
+// Names the calling thread's queue in stats, the name must outlive the event system
+void pong_events_setProducerName(const char *producer_name) {
+	struct PongEventProducer *producer = pong_events_internal_getThreadProducer();
+	if (producer)
+		atomic_store_explicit(&producer->name, producer_name, memory_order_relaxed);
+}
+
+// Any thread can push events, they're handled on whichever thread calls pong_events_pollEvents()
 void pong_events_pushFocusEvent(int is_focused) {
-	struct PongEvent event = (struct PongEvent) { PONG_EVENT_FOCUS, { .window_focus_event = { is_focused } } };
-	pong_events_internal_pushEvent(event);
+	pong_events_internal_pushEvent(PONG_EVENT_FOCUS, &is_focused, sizeof (int));
 }
 
 void pong_events_pushQuitEvent(void) {
-	struct PongEvent event = (struct PongEvent) { PONG_EVENT_QUIT };
-	pong_events_internal_pushEvent(event);
+	pong_events_internal_pushEvent(PONG_EVENT_QUIT, NULL, 0);
 }
 
 void pong_events_addCallback(enum PongEventType event_type, PongEventCallback callback) {
@@ -68,70 +232,406 @@ void pong_events_removeCallback(enum PongEventType event_type, PongEventCallback
 	PONG_LOG_SUBGROUP_END();
 }
 
-void pong_events_pollEvents(void) {
-	if (!event_queue.length)
+// Pushes a timer event delay_ticks polls from now, then every period_ticks polls after that if period_ticks isn't 0
+// A delay of 0 fires on the next poll, same as 1, the returned ID is passed to PONG_EVENT_TIMER callbacks
+// IDs are reused once a timer is cancelled or its last event fires, must only be called from the polling thread
+unsigned int pong_events_scheduleTimer(unsigned int delay_ticks, unsigned int period_ticks) {
+	PONG_LOG("Scheduling timer in %u ticks, repeating every %u ticks...", PONG_LOG_VERBOSE, delay_ticks, period_ticks);
+	unsigned int timer_id;
+	if (timer_wheel.free_id != PONG_EVENTS_INVALID_TIMER_ID) {
+		timer_id = timer_wheel.free_id;
+		timer_wheel.free_id = timer_wheel.timers[timer_id].next;
+	} else {
+		if (timer_wheel.used_count == timer_wheel.capacity) {
+			struct PongEventTimer *new_timers = realloc(timer_wheel.timers, sizeof (struct PongEventTimer) * timer_wheel.capacity * 2);
+			if (!new_timers)
+				PONG_ERROR("Could not reallocate memory for event timers!");
+			timer_wheel.timers = new_timers;
+			timer_wheel.capacity *= 2;
+		}
+		timer_id = timer_wheel.used_count++;
+	}
+	timer_wheel.timers[timer_id].period_ticks = period_ticks;
+	pong_events_internal_insertTimer(timer_id, timer_wheel.tick + (delay_ticks ? delay_ticks : 1));
+	timer_wheel.pending_count++;
+	return timer_id;
+}
+
+// Cancelling a timer that isn't pending does nothing, must only be called from the polling thread
+void pong_events_cancelTimer(unsigned int timer_id) {
+	PONG_LOG("Cancelling timer %u...", PONG_LOG_VERBOSE, timer_id);
+	if (timer_id >= timer_wheel.used_count || timer_wheel.timers[timer_id].slot == PONG_EVENTS_INVALID_TIMER_ID)
 		return;
+	pong_events_internal_unlinkTimer(timer_id);
+	pong_events_internal_freeTimer(timer_id);
+}
 
-	PONG_LOG_SUBGROUP_START("PollEvents");
-	PONG_LOG("Processing events (%i queued)...", PONG_LOG_VERBOSE, event_queue.length);
-	do {
-		struct PongEvent *event = event_queue.events[--event_queue.length];
-		PONG_LOG("Handling event type %i...", PONG_LOG_VERBOSE, event->type);
-		struct PongEventCallbackArray *event_callbacks = events_callbacks + event->type;
-		unsigned int is_handled = 0;
-		for (unsigned int i = 0; !is_handled && i < event_callbacks->length; i++)
-			is_handled = pong_events_internal_executeCallback(event_callbacks->callbacks[i], event->type, event->arguments);
-		if (is_handled)
-			PONG_LOG("Event was handled.", PONG_LOG_VERBOSE);
-		else
-			PONG_LOG("Event was not handled.", PONG_LOG_VERBOSE);
-		free(event);
-	} while (event_queue.length);
-	
-	PONG_LOG("All events processed.", PONG_LOG_VERBOSE);
-	free(event_queue.events);
-	event_queue.events = NULL;
-	PONG_LOG_SUBGROUP_END();
+void pong_events_pollEvents(void) {
+	pong_events_pollEventsBefore(~0ull);
 }
 
+// Handles every queued event pushed before deadline_nsec (from pong_timing_getNsec()), later ones wait for the next poll
+// Higher priorities go first, then events are handled in the order they were pushed across every thread
+// Timers due this poll fire first, every poll is taken to be a tick of the timer wheel
+// Must only be called from one thread
+void pong_events_pollEventsBefore(unsigned long long deadline_nsec) {
+	pong_events_internal_advanceTimers();
+#ifdef PONG_EVENTS_REPLAY
+	if (atomic_load_explicit(&is_replaying, memory_order_relaxed))
+		pong_events_internal_replayTick();
+#endif
+	struct PongEventProducer *producers = atomic_load_explicit(&event_producers, memory_order_acquire);
+	struct PongEventHeader header;
+	const unsigned char *payload;
+	struct PongEventArena *arena = pong_events_internal_findOldestEvent(producers, deadline_nsec, &header, &payload);
+	if (arena) {
+		PONG_LOG_SUBGROUP_START("PollEvents");
+		PONG_LOG("Processing events...", PONG_LOG_VERBOSE);
+		do {
+			arena->read += pong_events_internal_getRecordSize(header.size);
+#ifdef PONG_EVENTS_RECORD
+			pong_events_internal_recordEvent(&header, payload);
+#endif
+			pong_events_internal_dispatchEvent(&header, payload);
+		} while ((arena = pong_events_internal_findOldestEvent(producers, deadline_nsec, &header, &payload)));
+		PONG_LOG("All events processed.", PONG_LOG_VERBOSE);
+		PONG_LOG_SUBGROUP_END();
+	}
+
+	// Hands everything read back to the producers in one go, like resetting a bump allocator
+	for (struct PongEventProducer *producer = producers; producer; producer = producer->next)
+		for (unsigned int i = 0; i < PongEventPriorityCount; i++)
+			atomic_store_explicit(&producer->arenas[i].head, producer->arenas[i].read, memory_order_release);
+	event_tick++;
+}
+
+// When the event being handled was pushed, only meaningful from inside an event callback
+unsigned long long pong_events_getEventNsec(void) {
+	return dispatching_event_nsec;
+}
+
+// Steps through the queue of every thread that has pushed events, start iterator at 0 and call until it returns 0
+// Safe to call from any thread, though counts from other threads may be slightly out of date
+unsigned int pong_events_getQueueStats(unsigned int *iterator, struct PongEventQueueStats *stats) {
+	struct PongEventProducer *producer = atomic_load_explicit(&event_producers, memory_order_acquire);
+	for (unsigned int i = 0; producer && i < *iterator; i++)
+		producer = producer->next;
+	if (!producer)
+		return 0;
+	(*iterator)++;
+	*stats = (struct PongEventQueueStats) {
+		.producer_name = atomic_load_explicit(&producer->name, memory_order_relaxed),
+		.pushed_count = atomic_load_explicit(&producer->pushed_count, memory_order_relaxed),
+		.dropped_count = atomic_load_explicit(&producer->dropped_count, memory_order_relaxed),
+		.max_depth = atomic_load_explicit(&producer->max_depth, memory_order_relaxed),
+		.capacity = PONG_EVENTS_ARENA_SIZE
+	};
+	for (unsigned int i = 0; i < PongEventPriorityCount; i++)
+		stats->depth += atomic_load_explicit(&producer->arenas[i].tail, memory_order_relaxed) - atomic_load_explicit(&producer->arenas[i].head, memory_order_relaxed);
+	return 1;
+}
+
+// Every other thread that pushed events must have finished by now
 void pong_events_cleanup(void) {
 	PONG_LOG_SUBGROUP_START("Events");
 	PONG_LOG("Cleaning up events...", PONG_LOG_INFO);
+#ifdef PONG_LOGGING
+	struct PongEventQueueStats stats;
+	for (unsigned int iterator = 0; pong_events_getQueueStats(&iterator, &stats);)
+		PONG_LOG("Event queue of '%s': %lu pushed, %lu dropped, %u of %u bytes used at most.", PONG_LOG_VERBOSE,
+			stats.producer_name, stats.pushed_count, stats.dropped_count, stats.max_depth, stats.capacity);
+#endif
+#ifdef PONG_EVENTS_RECORD
+	if (recording_file) {
+		PONG_LOG("Finishing event recording after %lu ticks...", PONG_LOG_VERBOSE, event_tick);
+		if (ferror(recording_file) | fclose(recording_file))
+			PONG_LOG("Could not write event recording, it's incomplete!", PONG_LOG_WARNING);
+		recording_file = NULL;
+	}
+#endif
+#ifdef PONG_EVENTS_REPLAY
+	if (replay_data)
+		pong_files_unmapFile(replay_data, replay_size);
+	replay_data = NULL;
+	replay_size = replay_offset = 0;
+	atomic_store(&is_replaying, 0);
+#endif
 	PONG_LOG("Clearing any remaining events...", PONG_LOG_VERBOSE);
-	while (event_queue.length--)
-		free(event_queue.events[event_queue.length]);
-	free(event_queue.events);
+	pthread_mutex_lock(&event_producers_mutex);
+	are_producers_finished = 1;
+	struct PongEventProducer *producer = atomic_exchange(&event_producers, NULL);
+	while (producer) {
+		struct PongEventProducer *next = producer->next;
+		free(producer);
+		producer = next;
+	}
+	thread_producer = NULL;
+	pthread_mutex_unlock(&event_producers_mutex);
+	PONG_LOG("Clearing %u pending timers...", PONG_LOG_VERBOSE, timer_wheel.pending_count);
+	free(timer_wheel.timers);
+	timer_wheel.timers = NULL;
+	timer_wheel.capacity = timer_wheel.used_count = timer_wheel.pending_count = 0;
 	PONG_LOG("Clearing list of event callbacks...", PONG_LOG_VERBOSE);
 	for (unsigned int i = 0; i < PongEventTypeCount; i++)
 		free(events_callbacks[i].callbacks);
 	PONG_LOG_SUBGROUP_END();
 }
 
-static void pong_events_internal_pushEvent(struct PongEvent event_data) {
-	PONG_LOG_SUBGROUP_START("PushEvent");
-	PONG_LOG("Pushing event type %i...", PONG_LOG_VERBOSE, event_data.type);
-	unsigned int new_event_queue_len = event_queue.length + 1;
-	struct PongEvent **new_event_queue = realloc(event_queue.events, sizeof (struct PongEvent *) * new_event_queue_len);
-	struct PongEvent *event = malloc(sizeof (struct PongEvent));
-	if (!new_event_queue || !event)
-		PONG_ERROR("Could not allocate memory for new event!");
-	*event = event_data;
-	event_queue.events = new_event_queue;
-	event_queue.events[event_queue.length] = event;
-	event_queue.length = new_event_queue_len;
-	PONG_LOG_SUBGROUP_END();
+// Wait-free once the thread has its queues, events pushed while one is full are dropped rather than holding up the producer
+// The payload is copied, so it only has to last until this returns
+static void pong_events_internal_pushEvent(enum PongEventType event_type, const void *payload, unsigned int payload_size) {
+	PONG_LOG("Pushing event type %i...", PONG_LOG_VERBOSE, event_type);
+	if (payload_size > PONG_EVENTS_MAX_PAYLOAD_SIZE)
+		PONG_ERROR("Attempted to push event type %i with a %u byte payload, the most allowed is %u bytes!", event_type, payload_size, PONG_EVENTS_MAX_PAYLOAD_SIZE);
+#ifdef PONG_EVENTS_REPLAY
+	// Live input would make the replay diverge from the recording, it's let through again once the recording runs out
+	if (event_is_input[event_type] && atomic_load_explicit(&is_replaying, memory_order_relaxed))
+		return;
+#endif
+	struct PongEventProducer *producer = pong_events_internal_getThreadProducer();
+	if (!producer)
+		return;
+	struct PongEventArena *arena = producer->arenas + event_priorities[event_type];
+	unsigned int tail = atomic_load_explicit(&arena->tail, memory_order_relaxed);
+	unsigned int offset = tail & (PONG_EVENTS_ARENA_SIZE - 1), record_size = pong_events_internal_getRecordSize(payload_size);
+	unsigned int skipped_size = record_size > PONG_EVENTS_ARENA_SIZE - offset ? PONG_EVENTS_ARENA_SIZE - offset : 0;
+	unsigned int depth = tail - atomic_load_explicit(&arena->head, memory_order_acquire) + skipped_size + record_size;
+	if (depth > PONG_EVENTS_ARENA_SIZE) {
+		unsigned long dropped_count = atomic_load_explicit(&producer->dropped_count, memory_order_relaxed);
+		atomic_store_explicit(&producer->dropped_count, dropped_count + 1, memory_order_relaxed);
+		if (!dropped_count)
+			PONG_LOG("Event queue of '%s' is full (%u bytes), dropping its new events!", PONG_LOG_WARNING, atomic_load_explicit(&producer->name, memory_order_relaxed), PONG_EVENTS_ARENA_SIZE);
+		return;
+	}
+
+	// Too little room left for a header is skipped implicitly, anything more is marked so the poller knows to skip it
+	if (skipped_size >= sizeof (struct PongEventHeader))
+		memcpy(arena->bytes + offset, &(struct PongEventHeader) { .type = PongEventTypeCount }, sizeof (struct PongEventHeader));
+	offset = (offset + skipped_size) & (PONG_EVENTS_ARENA_SIZE - 1);
+	struct PongEventHeader header = { pong_timing_getNsec(), event_type, payload_size };
+	memcpy(arena->bytes + offset, &header, sizeof (struct PongEventHeader));
+	if (payload_size)
+		memcpy(arena->bytes + offset + sizeof (struct PongEventHeader), payload, payload_size);
+	atomic_store_explicit(&arena->tail, tail + skipped_size + record_size, memory_order_release);
+	atomic_store_explicit(&producer->pushed_count, atomic_load_explicit(&producer->pushed_count, memory_order_relaxed) + 1, memory_order_relaxed);
+	if (depth > atomic_load_explicit(&producer->max_depth, memory_order_relaxed))
+		atomic_store_explicit(&producer->max_depth, depth, memory_order_relaxed);
+}
+
+// Creates and registers the calling thread's queue on first use, returns NULL once events have been cleaned up
+static struct PongEventProducer *pong_events_internal_getThreadProducer(void) {
+	if (thread_producer)
+		return thread_producer;
+	pthread_mutex_lock(&event_producers_mutex);
+	if (!are_producers_finished) {
+		thread_producer = aligned_alloc(PONG_EVENTS_CACHE_LINE_SIZE, sizeof (struct PongEventProducer));
+		if (!thread_producer) {
+			pthread_mutex_unlock(&event_producers_mutex);
+			PONG_ERROR("Could not allocate memory for event queue!");
+		}
+		for (unsigned int i = 0; i < PongEventPriorityCount; i++) {
+			atomic_init(&thread_producer->arenas[i].head, 0);
+			atomic_init(&thread_producer->arenas[i].tail, 0);
+			thread_producer->arenas[i].read = 0;
+		}
+		atomic_init(&thread_producer->pushed_count, 0);
+		atomic_init(&thread_producer->dropped_count, 0);
+		atomic_init(&thread_producer->max_depth, 0);
+		atomic_init(&thread_producer->name, "unnamed");
+		thread_producer->next = atomic_load_explicit(&event_producers, memory_order_relaxed);
+		atomic_store_explicit(&event_producers, thread_producer, memory_order_release);
+	}
+	pthread_mutex_unlock(&event_producers_mutex);
+	return thread_producer;
 }
 
-static unsigned int pong_events_internal_executeCallback(PongEventCallback callback, enum PongEventType event_type, union PongEventArguments event_args) {
+// Returns the arena holding the next event to handle and copies out its header, or NULL if nothing queued was pushed before the deadline
+// Each arena is already in push order, so the oldest event of a priority is the next one read from one of them
+static struct PongEventArena *pong_events_internal_findOldestEvent(struct PongEventProducer *producers, unsigned long long deadline_nsec, struct PongEventHeader *header, const unsigned char **payload) {
+	for (unsigned int priority = 0; priority < PongEventPriorityCount; priority++) {
+		struct PongEventArena *oldest_arena = NULL;
+		for (struct PongEventProducer *producer = producers; producer; producer = producer->next) {
+			struct PongEventArena *arena = producer->arenas + priority;
+			struct PongEventHeader arena_header;
+			const unsigned char *record = pong_events_internal_peekEvent(arena, &arena_header);
+			if (record && arena_header.nsec < deadline_nsec && (!oldest_arena || arena_header.nsec < header->nsec)) {
+				oldest_arena = arena;
+				*header = arena_header;
+				*payload = record + sizeof (struct PongEventHeader);
+			}
+		}
+		if (oldest_arena)
+			return oldest_arena;
+	}
+	return NULL;
+}
+
+// Returns the next unread record and copies out its header, moving past the skipped end of the arena if need be
+static const unsigned char *pong_events_internal_peekEvent(struct PongEventArena *arena, struct PongEventHeader *header) {
+	unsigned int tail = atomic_load_explicit(&arena->tail, memory_order_acquire);
+	while (arena->read != tail) {
+		unsigned int offset = arena->read & (PONG_EVENTS_ARENA_SIZE - 1);
+		if (PONG_EVENTS_ARENA_SIZE - offset >= sizeof (struct PongEventHeader)) {
+			memcpy(header, arena->bytes + offset, sizeof (struct PongEventHeader));
+			if (header->type != PongEventTypeCount)
+				return arena->bytes + offset;
+		}
+		arena->read += PONG_EVENTS_ARENA_SIZE - offset;
+	}
+	return NULL;
+}
+
+static unsigned int pong_events_internal_getRecordSize(unsigned int payload_size) {
+	return (sizeof (struct PongEventHeader) + payload_size + PONG_EVENTS_RECORD_ALIGNMENT - 1) & ~(PONG_EVENTS_RECORD_ALIGNMENT - 1);
+}
+
+static void pong_events_internal_dispatchEvent(const struct PongEventHeader *header, const void *payload) {
+	PONG_LOG("Handling event type %i...", PONG_LOG_VERBOSE, header->type);
+	dispatching_event_nsec = header->nsec;
+	struct PongEventCallbackArray *event_callbacks = events_callbacks + header->type;
+	unsigned int is_handled = 0;
+	for (unsigned int i = 0; !is_handled && i < event_callbacks->length; i++)
+		is_handled = pong_events_internal_executeCallback(event_callbacks->callbacks[i], header->type, payload);
+	if (is_handled)
+		PONG_LOG("Event was handled.", PONG_LOG_VERBOSE);
+	else
+		PONG_LOG("Event was not handled.", PONG_LOG_VERBOSE);
+}
+
+// Payloads are aligned to PONG_EVENTS_RECORD_ALIGNMENT, so they can be read in place as whatever was pushed
+static unsigned int pong_events_internal_executeCallback(PongEventCallback callback, enum PongEventType event_type, const void *payload) {
 	PONG_LOG_SUBGROUP_START("ExecEventCallback");
 	PONG_LOG("Executing callback %p...", PONG_LOG_VERBOSE, &callback);
 	unsigned int return_code = 0;
 	switch (event_type) {
-		case PONG_EVENT_FOCUS: return_code = callback(event_args.window_focus_event.is_focused); break;
+		case PONG_EVENT_FOCUS: return_code = callback(*(const int *) payload); break;
 		case PONG_EVENT_QUIT:  return_code = callback(); break;
+		case PONG_EVENT_TIMER: return_code = callback(*(const unsigned int *) payload); break;
 		default: PONG_ERROR("Attempted to execute callback for invalid event type %i!", event_type);
 	}
 	PONG_LOG_SUBGROUP_END();
 	return return_code;
 }
 
+// Moves the wheel on a tick and fires every timer now due, repeating timers are rescheduled before their event is handled
+// Timers are popped one at a time rather than walking the slot, as callbacks are free to schedule and cancel timers
+static void pong_events_internal_advanceTimers(void) {
+	unsigned long long tick = ++timer_wheel.tick;
+	unsigned int top_level = 0;
+	while (top_level < PONG_EVENTS_TIMER_WHEEL_LEVELS - 1 && !(tick >> (PONG_EVENTS_TIMER_WHEEL_BITS * top_level) & (PONG_EVENTS_TIMER_WHEEL_SIZE - 1)))
+		top_level++;
+	for (unsigned int level = top_level; level > 0; level--) {
+		unsigned int *slot = timer_wheel.slots + level * PONG_EVENTS_TIMER_WHEEL_SIZE + (tick >> (PONG_EVENTS_TIMER_WHEEL_BITS * level) & (PONG_EVENTS_TIMER_WHEEL_SIZE - 1));
+		for (unsigned int timer_id; (timer_id = *slot) != PONG_EVENTS_INVALID_TIMER_ID;) {
+			pong_events_internal_unlinkTimer(timer_id);
+			pong_events_internal_insertTimer(timer_id, timer_wheel.timers[timer_id].due_tick);
+		}
+	}
+
+	unsigned int *slot = timer_wheel.slots + (tick & (PONG_EVENTS_TIMER_WHEEL_SIZE - 1));
+	if (*slot == PONG_EVENTS_INVALID_TIMER_ID)
+		return;
+	PONG_LOG_SUBGROUP_START("FireTimers");
+	for (unsigned int timer_id; (timer_id = *slot) != PONG_EVENTS_INVALID_TIMER_ID;) {
+		pong_events_internal_unlinkTimer(timer_id);
+		if (timer_wheel.timers[timer_id].period_ticks)
+			pong_events_internal_insertTimer(timer_id, tick + timer_wheel.timers[timer_id].period_ticks);
+		else
+			pong_events_internal_freeTimer(timer_id);
+		struct PongEventHeader header = { pong_timing_getNsec(), PONG_EVENT_TIMER, sizeof (unsigned int) };
+		pong_events_internal_dispatchEvent(&header, &timer_id);
+	}
+	PONG_LOG_SUBGROUP_END();
+}
+
+// Files the timer under the lowest level that can tell its due tick apart from the current one
+static void pong_events_internal_insertTimer(unsigned int timer_id, unsigned long long due_tick) {
+	struct PongEventTimer *timer = timer_wheel.timers + timer_id;
+	unsigned long long remaining_ticks = due_tick - timer_wheel.tick;
+	unsigned int level = 0;
+	while (level < PONG_EVENTS_TIMER_WHEEL_LEVELS - 1 && remaining_ticks >> (PONG_EVENTS_TIMER_WHEEL_BITS * (level + 1)))
+		level++;
+	timer->due_tick = due_tick;
+	timer->slot = level * PONG_EVENTS_TIMER_WHEEL_SIZE + (due_tick >> (PONG_EVENTS_TIMER_WHEEL_BITS * level) & (PONG_EVENTS_TIMER_WHEEL_SIZE - 1));
+	timer->prev = PONG_EVENTS_INVALID_TIMER_ID;
+	timer->next = timer_wheel.slots[timer->slot];
+	if (timer->next != PONG_EVENTS_INVALID_TIMER_ID)
+		timer_wheel.timers[timer->next].prev = timer_id;
+	timer_wheel.slots[timer->slot] = timer_id;
+}
+
+static void pong_events_internal_unlinkTimer(unsigned int timer_id) {
+	struct PongEventTimer *timer = timer_wheel.timers + timer_id;
+	if (timer->prev != PONG_EVENTS_INVALID_TIMER_ID)
+		timer_wheel.timers[timer->prev].next = timer->next;
+	else
+		timer_wheel.slots[timer->slot] = timer->next;
+	if (timer->next != PONG_EVENTS_INVALID_TIMER_ID)
+		timer_wheel.timers[timer->next].prev = timer->prev;
+	timer->slot = PONG_EVENTS_INVALID_TIMER_ID;
+}
+
+static void pong_events_internal_freeTimer(unsigned int timer_id) {
+	timer_wheel.timers[timer_id].next = timer_wheel.free_id;
+	timer_wheel.free_id = timer_id;
+	timer_wheel.pending_count--;
+}
+
+#if defined(PONG_EVENTS_RECORD) || defined(PONG_EVENTS_REPLAY)
+static char *pong_events_internal_getRecordingFilePath(void) {
+	const char *data_directory = pong_files_getDataDirectoryPath();
+	char *recording_file_path = malloc(sizeof (char) * (strlen(data_directory) + strlen(PONG_EVENTS_RECORDING_FILE) + 1));
+	if (!recording_file_path)
+		PONG_ERROR("Could not allocate memory for event recording file path!");
+	return strcat(strcpy(recording_file_path, data_directory), PONG_EVENTS_RECORDING_FILE);
+}
+#endif
+
+#ifdef PONG_EVENTS_RECORD
+// Events are recorded as they're handled rather than pushed, so replays see the same events on the same ticks in the same order
+// Timer events aren't recorded, replays fire them again from whatever the replayed callbacks schedule
+static void pong_events_internal_recordEvent(const struct PongEventHeader *header, const void *payload) {
+	unsigned char record_header[PONG_EVENTS_RECORD_HEADER_SIZE];
+	for (unsigned int i = 0; i < 4; i++)
+		record_header[i] = event_tick >> (i * 8);
+	for (unsigned int i = 0; i < 2; i++) {
+		record_header[i + 4] = header->type >> (i * 8);
+		record_header[i + 6] = header->size >> (i * 8);
+	}
+	fwrite(record_header, 1, PONG_EVENTS_RECORD_HEADER_SIZE, recording_file);
+	fwrite(payload, 1, header->size, recording_file);
+}
+#endif
+
+#ifdef PONG_EVENTS_REPLAY
+// Handles every recorded event for the current tick, straight from the recording without going through the queues
+// Runs before the queues are polled, which only hold live events that aren't input while replaying
+static void pong_events_internal_replayTick(void) {
+	_Alignas(PONG_EVENTS_RECORD_ALIGNMENT) unsigned char payload[PONG_EVENTS_MAX_PAYLOAD_SIZE];
+	while (replay_offset < replay_size) {
+		if (replay_size - replay_offset < PONG_EVENTS_RECORD_HEADER_SIZE)
+			PONG_ERROR("Event recording is truncated!");
+		const unsigned char *record = replay_data + replay_offset;
+		unsigned long record_tick = pong_events_internal_readU32(record);
+		if (record_tick > event_tick)
+			return;
+		struct PongEventHeader header = { pong_timing_getNsec(), record[4] | record[5] << 8, record[6] | record[7] << 8 };
+		if (record_tick < event_tick || header.type >= PongEventTypeCount || header.size > PONG_EVENTS_MAX_PAYLOAD_SIZE)
+			PONG_ERROR("Event recording is corrupt!");
+		if (header.size > replay_size - replay_offset - PONG_EVENTS_RECORD_HEADER_SIZE)
+			PONG_ERROR("Event recording is truncated!");
+		// Copied out as records are packed without padding, callbacks expect their payload to be aligned
+		memcpy(payload, record + PONG_EVENTS_RECORD_HEADER_SIZE, header.size);
+		replay_offset += PONG_EVENTS_RECORD_HEADER_SIZE + header.size;
+		PONG_LOG_SUBGROUP_START("ReplayEvents");
+		pong_events_internal_dispatchEvent(&header, payload);
+		PONG_LOG_SUBGROUP_END();
+	}
+	PONG_LOG("Event replay finished on tick %lu, handling live input again.", PONG_LOG_NOTEWORTHY, event_tick);
+	atomic_store(&is_replaying, 0);
+}
+
+static unsigned int pong_events_internal_readU32(const unsigned char *bytes) {
+	return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (unsigned int) bytes[3] << 24;
+}
+#endif
@@ -1,19 +1,48 @@
 #ifndef PONG_EVENTS_H
 #define PONG_EVENTS_H
 
+#define PONG_EVENTS_INVALID_TIMER_ID 0xffffffffu
+
 typedef unsigned int (*PongEventCallback)();
 
 enum PongEventType {
 	PONG_EVENT_FOCUS,
 	PONG_EVENT_QUIT,
+	PONG_EVENT_TIMER,
 	PongEventTypeCount
 };
 
+// Higher priority events are handled before any lower priority ones that are queued
+enum PongEventPriority {
+	PONG_EVENT_PRIORITY_HIGH,
+	PONG_EVENT_PRIORITY_NORMAL,
+	PONG_EVENT_PRIORITY_LOW,
+	PongEventPriorityCount
+};
+
+// Every thread that pushes events has its own queue, dropped events are ones pushed while it was full
+// Depths and capacity are in bytes, as events take up as much room as their payload needs
+struct PongEventQueueStats {
+	const char *producer_name;
+	unsigned long pushed_count;
+	unsigned long dropped_count;
+	unsigned int depth;
+	unsigned int max_depth;
+	unsigned int capacity;
+};
+
+void pong_events_init(void);
+void pong_events_setProducerName(const char *producer_name);
 void pong_events_pushFocusEvent(int is_focused);
 void pong_events_pushQuitEvent(void);
 void pong_events_addCallback(enum PongEventType event_type, PongEventCallback callback);
 void pong_events_removeCallback(enum PongEventType event_type, PongEventCallback callback);
+unsigned int pong_events_scheduleTimer(unsigned int delay_ticks, unsigned int period_ticks);
+void pong_events_cancelTimer(unsigned int timer_id);
 void pong_events_pollEvents(void);
+void pong_events_pollEventsBefore(unsigned long long deadline_nsec);
+unsigned long long pong_events_getEventNsec(void);
+unsigned int pong_events_getQueueStats(unsigned int *iterator, struct PongEventQueueStats *stats);
 void pong_events_cleanup(void);
 
 #endif // PONG_EVENTS_H
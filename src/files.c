@@ -8,6 +8,9 @@
 #include <windows.h>
 #elif PONG_PLATFORM_LINUX
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 static char *data_directory_path;
@@ -48,6 +51,54 @@ const char *pong_files_getDataDirectoryPath(void) {
 	return (const char *) data_directory_path;
 }
 
+// Maps the whole file read-only into memory, which stays valid until it's passed to pong_files_unmapFile()
+const void *pong_files_mapFile(const char *file_path, size_t *file_size) {
+	PONG_LOG("Mapping '%s' into memory...", PONG_LOG_VERBOSE, file_path);
+#ifdef PONG_PLATFORM_WINDOWS
+	HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		PONG_ERROR("Could not open '%s' for mapping!", file_path);
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || !size.QuadPart) {
+		CloseHandle(file);
+		PONG_ERROR("Could not get the size of '%s' for mapping!", file_path);
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping)
+		PONG_ERROR("Could not create a mapping of '%s'!", file_path);
+	const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data)
+		PONG_ERROR("Could not map '%s' into memory!", file_path);
+	*file_size = size.QuadPart;
+#elif PONG_PLATFORM_LINUX
+	int file = open(file_path, O_RDONLY);
+	if (file == -1)
+		PONG_ERROR("Could not open '%s' for mapping!", file_path);
+	struct stat stat;
+	if (fstat(file, &stat) || !stat.st_size) {
+		close(file);
+		PONG_ERROR("Could not get the size of '%s' for mapping!", file_path);
+	}
+	void *data = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+		PONG_ERROR("Could not map '%s' into memory!", file_path);
+	*file_size = stat.st_size;
+#endif
+	PONG_LOG("Mapped %zu bytes of '%s'.", PONG_LOG_VERBOSE, *file_size, file_path);
+	return data;
+}
+
+void pong_files_unmapFile(const void *data, size_t file_size) {
+#ifdef PONG_PLATFORM_WINDOWS
+	UnmapViewOfFile(data);
+#elif PONG_PLATFORM_LINUX
+	munmap((void *) data, file_size);
+#endif
+}
+
 void pong_files_cleanup(void) {
 	PONG_LOG_SUBGROUP_START("Files");
 	PONG_LOG("Cleaning up file manager...", PONG_LOG_INFO);
@@ -1,8 +1,12 @@
 #ifndef PONG_FILES_H
 #define PONG_FILES_H
 
+#include <stddef.h>
+
 void pong_files_init(void);
 const char *pong_files_getDataDirectoryPath(void);
+const void *pong_files_mapFile(const char *file_path, size_t *file_size);
+void pong_files_unmapFile(const void *data, size_t file_size);
 void pong_files_cleanup(void);
 
 #endif // PONG_FILES_H
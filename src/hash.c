@@ -0,0 +1,18 @@
+#include "hash.h"
+
+// Kept free of other modules so tools/resids.c can build with it and hash resource IDs ahead of time
+
+// Using djb2 hashing algorithm because I'm that basic
+// Its low bits barely change between similar keys, so it's finished with MurmurHash3's mixer before being masked
+// 0 marks an empty slot in hash maps, so it's never returned as a hash
+unsigned int pong_hash_string(const char *string) {
+	unsigned int hash = 5381;
+	for (const char *string_char = string; *string_char; string_char++)
+		hash = ((hash << 5) + hash) + (unsigned char) *string_char;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash ? hash : 1;
+}
@@ -0,0 +1,6 @@
+#ifndef PONG_HASH_H
+#define PONG_HASH_H
+
+unsigned int pong_hash_string(const char *string);
+
+#endif // PONG_HASH_H
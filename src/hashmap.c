@@ -0,0 +1,304 @@
+#include "hashmap.h"
+#include "hash.h"
+#include "log.h"
+#include "error.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef PONG_HASHMAP_BENCHMARK
+#include "timing.h"
+#include <stdio.h>
+#endif
+
+#define PONG_HASHMAP_MIN_CAPACITY 8
+
+#ifdef PONG_HASHMAP_BENCHMARK
+#ifndef PONG_LOGGING
+#error PONG_HASHMAP_BENCHMARK needs PONG_LOGGING to report its results!
+#endif
+#define PONG_HASHMAP_BENCHMARK_OPERATIONS 1000000
+#define PONG_HASHMAP_BENCHMARK_KEY_SIZE 24 // fits "sprite" and any unsigned int
+#endif
+
+static void pong_hashmap_internal_allocate(struct PongHashMap *map, unsigned int capacity);
+static void pong_hashmap_internal_resize(struct PongHashMap *map, unsigned int new_capacity);
+static unsigned int pong_hashmap_internal_place(struct PongHashMap *map, unsigned int hash, const char *key, const void *value);
+static unsigned int pong_hashmap_internal_find(const struct PongHashMap *map, unsigned int hash, const char *key);
+static unsigned int pong_hashmap_internal_findHash(const struct PongHashMap *map, unsigned int hash);
+static unsigned int pong_hashmap_internal_getProbeDistance(const struct PongHashMap *map, unsigned int index);
+#ifdef PONG_HASHMAP_BENCHMARK
+static void pong_hashmap_internal_benchmarkSize(unsigned int entry_count);
+#endif
+
+void pong_hashmap_init(struct PongHashMap *map, size_t value_size) {
+	*map = (struct PongHashMap) { .value_size = value_size };
+	map->swap_value = malloc(value_size * 2);
+	if (!map->swap_value)
+		PONG_ERROR("Could not allocate memory for hash map!");
+	pong_hashmap_internal_allocate(map, PONG_HASHMAP_MIN_CAPACITY);
+}
+
+// Returns the new entry's zeroed value, or NULL if the key is already in the map
+// Any value pointers held from before are invalidated
+void *pong_hashmap_insert(struct PongHashMap *map, const char *key) {
+	unsigned int hash = pong_hash_string(key);
+	if (pong_hashmap_internal_find(map, hash, key) != map->capacity)
+		return NULL;
+	if ((map->count + 1) * 5 > map->capacity * 4)
+		pong_hashmap_internal_resize(map, map->capacity * 2);
+	memset(map->swap_value, 0, map->value_size);
+	unsigned int index = pong_hashmap_internal_place(map, hash, key, map->swap_value);
+	map->count++;
+	return map->values + index * map->value_size;
+}
+
+// Returns the key's value, or NULL if the key isn't in the map
+void *pong_hashmap_get(const struct PongHashMap *map, const char *key) {
+	unsigned int index = pong_hashmap_internal_find(map, pong_hash_string(key), key);
+	return index != map->capacity ? map->values + index * map->value_size : NULL;
+}
+
+// Same as pong_hashmap_get() for a key already hashed with pong_hash_string(), without touching any strings
+// Keys with the same hash can't be told apart this way, so it's only for maps that keep their keys' hashes unique
+void *pong_hashmap_getHashed(const struct PongHashMap *map, unsigned int hash) {
+	unsigned int index = pong_hashmap_internal_findHash(map, hash);
+	return index != map->capacity ? map->values + index * map->value_size : NULL;
+}
+
+// Copies the removed value out if removed_value isn't NULL, returns 0 if the key wasn't in the map
+// Later entries in the probe sequence are shifted back into the gap, so no tombstones are left behind
+unsigned int pong_hashmap_remove(struct PongHashMap *map, const char *key, void *removed_value) {
+	unsigned int index = pong_hashmap_internal_find(map, pong_hash_string(key), key);
+	if (index == map->capacity)
+		return 0;
+	if (removed_value)
+		memcpy(removed_value, map->values + index * map->value_size, map->value_size);
+
+	unsigned int mask = map->capacity - 1;
+	for (unsigned int next = (index + 1) & mask; map->hashes[next] && pong_hashmap_internal_getProbeDistance(map, next); next = (next + 1) & mask) {
+		map->hashes[index] = map->hashes[next];
+		map->keys[index] = map->keys[next];
+		memcpy(map->values + index * map->value_size, map->values + next * map->value_size, map->value_size);
+		index = next;
+	}
+	map->hashes[index] = 0;
+	map->keys[index] = NULL;
+	map->count--;
+
+	if (map->capacity > PONG_HASHMAP_MIN_CAPACITY && map->count * 5 < map->capacity)
+		pong_hashmap_internal_resize(map, map->capacity / 2);
+	return 1;
+}
+
+// Returns how many slots a lookup checks to find the entry holding value, which must be a value pointer from this map
+unsigned int pong_hashmap_getProbeLength(const struct PongHashMap *map, const void *value) {
+	unsigned int index = ((const unsigned char *) value - map->values) / map->value_size;
+	return pong_hashmap_internal_getProbeDistance(map, index) + 1;
+}
+
+void pong_hashmap_getStats(const struct PongHashMap *map, struct PongHashMapStats *stats) {
+	*stats = (struct PongHashMapStats) { .count = map->count, .capacity = map->capacity };
+	for (unsigned int i = 0; i < map->capacity; i++) {
+		if (map->hashes[i]) {
+			unsigned int probe_length = pong_hashmap_internal_getProbeDistance(map, i) + 1;
+			stats->total_probe_length += probe_length;
+			if (probe_length > stats->max_probe_length)
+				stats->max_probe_length = probe_length;
+		}
+	}
+}
+
+// Steps through every entry, start iterator at 0 and call until it returns 0
+// The map mustn't be modified while iterating
+unsigned int pong_hashmap_iterate(const struct PongHashMap *map, unsigned int *iterator, const char **key, void **value) {
+	while (*iterator < map->capacity) {
+		unsigned int index = (*iterator)++;
+		if (map->hashes[index]) {
+			if (key)
+				*key = map->keys[index];
+			if (value)
+				*value = map->values + index * map->value_size;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void pong_hashmap_cleanup(struct PongHashMap *map) {
+	free(map->hashes);
+	free(map->keys);
+	free(map->values);
+	free(map->swap_value);
+	*map = (struct PongHashMap) { 0 };
+}
+
+#ifdef PONG_HASHMAP_BENCHMARK
+// Times inserting, finding, missing and removing keys in maps of a few different sizes
+void pong_hashmap_runBenchmark(void) {
+	PONG_LOG_SUBGROUP_START("Benchmark");
+	PONG_LOG("Benchmarking hash map...", PONG_LOG_NOTEWORTHY);
+	pong_hashmap_internal_benchmarkSize(10);
+	pong_hashmap_internal_benchmarkSize(1000);
+	pong_hashmap_internal_benchmarkSize(100000);
+	PONG_LOG_SUBGROUP_END();
+}
+#endif
+
+static void pong_hashmap_internal_allocate(struct PongHashMap *map, unsigned int capacity) {
+	map->hashes = calloc(capacity, sizeof (unsigned int));
+	map->keys = calloc(capacity, sizeof (const char *));
+	map->values = malloc(capacity * map->value_size);
+	if (!map->hashes || !map->keys || !map->values)
+		PONG_ERROR("Could not allocate memory for hash map!");
+	map->capacity = capacity;
+}
+
+static void pong_hashmap_internal_resize(struct PongHashMap *map, unsigned int new_capacity) {
+	unsigned int *old_hashes = map->hashes;
+	const char **old_keys = map->keys;
+	unsigned char *old_values = map->values;
+	unsigned int old_capacity = map->capacity;
+	pong_hashmap_internal_allocate(map, new_capacity);
+	for (unsigned int i = 0; i < old_capacity; i++)
+		if (old_hashes[i])
+			pong_hashmap_internal_place(map, old_hashes[i], old_keys[i], old_values + i * map->value_size);
+	free(old_hashes);
+	free(old_keys);
+	free(old_values);
+}
+
+// Robin Hood insertion: an entry further from its home slot takes the place of one closer to its own
+// Returns the index the new entry ended up at, the map must already have room for it
+static unsigned int pong_hashmap_internal_place(struct PongHashMap *map, unsigned int hash, const char *key, const void *value) {
+	unsigned char *carried_value = map->swap_value, *swapped_value = map->swap_value + map->value_size;
+	if (value != carried_value)
+		memcpy(carried_value, value, map->value_size);
+	unsigned int mask = map->capacity - 1, index = hash & mask, placed_index = map->capacity;
+	for (unsigned int distance = 0; map->hashes[index]; index = (index + 1) & mask, distance++) {
+		unsigned int existing_distance = pong_hashmap_internal_getProbeDistance(map, index);
+		if (existing_distance < distance) {
+			unsigned int existing_hash = map->hashes[index];
+			const char *existing_key = map->keys[index];
+			unsigned char *slot_value = map->values + index * map->value_size;
+			memcpy(swapped_value, slot_value, map->value_size);
+			map->hashes[index] = hash;
+			map->keys[index] = key;
+			memcpy(slot_value, carried_value, map->value_size);
+			hash = existing_hash;
+			key = existing_key;
+			memcpy(carried_value, swapped_value, map->value_size);
+			if (placed_index == map->capacity)
+				placed_index = index;
+			distance = existing_distance;
+		}
+	}
+	map->hashes[index] = hash;
+	map->keys[index] = key;
+	memcpy(map->values + index * map->value_size, carried_value, map->value_size);
+	return placed_index != map->capacity ? placed_index : index;
+}
+
+// Returns the key's index, or the map's capacity if it's not there
+// Stops early once it reaches an entry closer to its home slot than the key would be
+static unsigned int pong_hashmap_internal_find(const struct PongHashMap *map, unsigned int hash, const char *key) {
+	unsigned int mask = map->capacity - 1, index = hash & mask;
+	for (unsigned int distance = 0; map->hashes[index] && pong_hashmap_internal_getProbeDistance(map, index) >= distance; index = (index + 1) & mask, distance++)
+		if (map->hashes[index] == hash && !strcmp(map->keys[index], key))
+			return index;
+	return map->capacity;
+}
+
+static unsigned int pong_hashmap_internal_findHash(const struct PongHashMap *map, unsigned int hash) {
+	unsigned int mask = map->capacity - 1, index = hash & mask;
+	for (unsigned int distance = 0; map->hashes[index] && pong_hashmap_internal_getProbeDistance(map, index) >= distance; index = (index + 1) & mask, distance++)
+		if (map->hashes[index] == hash)
+			return index;
+	return map->capacity;
+}
+
+static unsigned int pong_hashmap_internal_getProbeDistance(const struct PongHashMap *map, unsigned int index) {
+	return (index - map->hashes[index]) & (map->capacity - 1);
+}
+
+#ifdef PONG_HASHMAP_BENCHMARK
+static void pong_hashmap_internal_benchmarkSize(unsigned int entry_count) {
+	char *keys = malloc(sizeof (char) * PONG_HASHMAP_BENCHMARK_KEY_SIZE * entry_count);
+	char *missing_keys = malloc(sizeof (char) * PONG_HASHMAP_BENCHMARK_KEY_SIZE * entry_count);
+	unsigned int *hashes = malloc(sizeof (unsigned int) * entry_count);
+	if (!keys || !missing_keys || !hashes)
+		PONG_ERROR("Could not allocate memory for hash map benchmark!");
+	for (unsigned int i = 0; i < entry_count; i++) {
+		snprintf(keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE, PONG_HASHMAP_BENCHMARK_KEY_SIZE, "sprite%u", i);
+		snprintf(missing_keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE, PONG_HASHMAP_BENCHMARK_KEY_SIZE, "sound%u", i);
+		hashes[i] = pong_hash_string(keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE);
+	}
+
+	unsigned int rounds = (PONG_HASHMAP_BENCHMARK_OPERATIONS + entry_count - 1) / entry_count;
+	unsigned long long insert_nsec = 0, hit_nsec = 0, hashed_hit_nsec = 0, miss_nsec = 0, remove_nsec = 0;
+	unsigned int mismatch_count = 0, max_distance = 0, total_distance = 0;
+	for (unsigned int round = 0; round < rounds; round++) {
+		struct PongHashMap map;
+		pong_hashmap_init(&map, sizeof (unsigned int));
+		unsigned long long start_nsec = pong_timing_getNsec();
+		for (unsigned int i = 0; i < entry_count; i++) {
+			unsigned int *value = pong_hashmap_insert(&map, keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE);
+			if (value)
+				*value = i;
+			else
+				mismatch_count++;
+		}
+		unsigned long long end_nsec = pong_timing_getNsec();
+		insert_nsec += end_nsec - start_nsec;
+
+		if (!round) {
+			for (unsigned int i = 0; i < map.capacity; i++) {
+				if (map.hashes[i]) {
+					unsigned int distance = pong_hashmap_internal_getProbeDistance(&map, i);
+					total_distance += distance;
+					if (distance > max_distance)
+						max_distance = distance;
+				}
+			}
+		}
+
+		start_nsec = pong_timing_getNsec();
+		for (unsigned int i = 0; i < entry_count; i++) {
+			unsigned int *value = pong_hashmap_get(&map, keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE);
+			mismatch_count += !value || *value != i;
+		}
+		end_nsec = pong_timing_getNsec();
+		hit_nsec += end_nsec - start_nsec;
+
+		start_nsec = pong_timing_getNsec();
+		for (unsigned int i = 0; i < entry_count; i++) {
+			unsigned int *value = pong_hashmap_getHashed(&map, hashes[i]);
+			mismatch_count += !value || *value != i;
+		}
+		end_nsec = pong_timing_getNsec();
+		hashed_hit_nsec += end_nsec - start_nsec;
+
+		start_nsec = pong_timing_getNsec();
+		for (unsigned int i = 0; i < entry_count; i++)
+			mismatch_count += pong_hashmap_get(&map, missing_keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE) != NULL;
+		end_nsec = pong_timing_getNsec();
+		miss_nsec += end_nsec - start_nsec;
+
+		start_nsec = pong_timing_getNsec();
+		for (unsigned int i = 0; i < entry_count; i++)
+			mismatch_count += !pong_hashmap_remove(&map, keys + i * PONG_HASHMAP_BENCHMARK_KEY_SIZE, NULL);
+		end_nsec = pong_timing_getNsec();
+		remove_nsec += end_nsec - start_nsec;
+		mismatch_count += map.count != 0 || map.capacity != PONG_HASHMAP_MIN_CAPACITY;
+		pong_hashmap_cleanup(&map);
+	}
+
+	double operation_count = (double) rounds * entry_count;
+	PONG_LOG("%u entries: insert %.1fns, hit %.1fns, hashed hit %.1fns, miss %.1fns, remove %.1fns (mean probe %.2f, max probe %u)", PONG_LOG_INFO,
+		entry_count, insert_nsec / operation_count, hit_nsec / operation_count, hashed_hit_nsec / operation_count, miss_nsec / operation_count, remove_nsec / operation_count,
+		(double) total_distance / entry_count, max_distance);
+	if (mismatch_count)
+		PONG_LOG("Hash map returned %u wrong results with %u entries!", PONG_LOG_WARNING, mismatch_count, entry_count);
+	free(keys);
+	free(missing_keys);
+	free(hashes);
+}
+#endif
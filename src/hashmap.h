@@ -0,0 +1,39 @@
+#ifndef PONG_HASHMAP_H
+#define PONG_HASHMAP_H
+
+#include <stddef.h>
+
+// Robin Hood hash map from string keys to fixed-size values stored inline
+// Keys aren't copied, so they must outlive their entries
+struct PongHashMap {
+	unsigned int *hashes;
+	const char **keys;
+	unsigned char *values;
+	unsigned char *swap_value;
+	size_t value_size;
+	unsigned int capacity;
+	unsigned int count;
+};
+
+// Probe lengths count the slots a successful lookup checks, so an entry in its home slot has a length of 1
+struct PongHashMapStats {
+	unsigned int count;
+	unsigned int capacity;
+	unsigned long long total_probe_length;
+	unsigned int max_probe_length;
+};
+
+void pong_hashmap_init(struct PongHashMap *map, size_t value_size);
+void *pong_hashmap_insert(struct PongHashMap *map, const char *key);
+void *pong_hashmap_get(const struct PongHashMap *map, const char *key);
+void *pong_hashmap_getHashed(const struct PongHashMap *map, unsigned int hash);
+unsigned int pong_hashmap_remove(struct PongHashMap *map, const char *key, void *removed_value);
+unsigned int pong_hashmap_getProbeLength(const struct PongHashMap *map, const void *value);
+void pong_hashmap_getStats(const struct PongHashMap *map, struct PongHashMapStats *stats);
+unsigned int pong_hashmap_iterate(const struct PongHashMap *map, unsigned int *iterator, const char **key, void **value);
+void pong_hashmap_cleanup(struct PongHashMap *map);
+#ifdef PONG_HASHMAP_BENCHMARK
+void pong_hashmap_runBenchmark(void);
+#endif
+
+#endif // PONG_HASHMAP_H
@@ -7,6 +7,8 @@
 #include <stdarg.h>
 #include <time.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #ifdef PONG_FILE_LOGGING
 #include <zlib.h>
 #if PONG_PLATFORM_WINDOWS
@@ -20,7 +22,24 @@
 #define PONG_LOG_FILE "latest.txt"
 #endif
 
+#define PONG_LOG_QUEUE_CAPACITY 1024 // must be a power of two
+#define PONG_LOG_LINE_MAX_LEN 512
+#define PONG_LOG_WRITER_BATCH_SIZE 65536
+#define PONG_LOG_WRITER_IDLE_NSEC 1000000
+
+// Slot in the log queue, sequence tracks which lap of the ring the slot is ready for
+// This is Vyukov's bounded queue so any thread can produce without taking a lock
+struct PongLogLine {
+	atomic_uint sequence;
+	unsigned int length;
+	char text[PONG_LOG_LINE_MAX_LEN];
+};
+
 static void pong_log_internal_generateGroupsString();
+static unsigned int pong_log_internal_formatLine(char *line, float time_since_init, enum PongLogUrgency urgency, const char *message, va_list args);
+static struct PongLogLine *pong_log_internal_claimLine(unsigned int *position);
+static void *pong_log_internal_writerThread(void *arg);
+static void pong_log_internal_freeThreadGroups(void *arg);
 
 #ifdef PONG_COLORED_LOGS
 static const char *log_colors[PongLogUrgencyCount + 1] = { "\033[2;37m", "\033[0;37m", "\033[1;32m", "\033[1;33m", "\033[7;31m", "\033[0m" };
@@ -33,15 +52,32 @@ static char *log_directory_path;
 static char *log_file_path;
 static char *compressed_log_file_path;
 #endif
+static FILE *log_file;
 
 static const char *urgency_labels[PongLogUrgencyCount] = { "VERB", "INFO", "NOTE", "WARN", "ERRR" };
-static const char **group_titles;
-static unsigned int group_titles_len;
-static char *groups_string;
+static _Thread_local const char **group_titles;
+static _Thread_local unsigned int group_titles_len;
+static _Thread_local char *groups_string;
+static pthread_key_t groups_key; // only used to free other threads' subgroups when they exit, kept until the process ends
 static struct timespec init_time;
 
+static struct PongLogLine *log_queue;
+static atomic_uint log_queue_enqueue_position;
+static unsigned int log_queue_dequeue_position;
+static pthread_t log_writer_thread;
+// Lines are only queued while is_writer_running, active_producer_count covers any thread between checking it and queuing
+// Cleanup sets is_writer_stopping before clearing it, then the writer waits for those threads before its final drain
+static atomic_int is_writer_running;
+static atomic_int is_writer_stopping;
+static atomic_uint active_producer_count;
+static atomic_ulong queued_line_count, written_line_count, dropped_line_count, truncated_line_count;
+
 int pong_log_internal_init(void) {
 	clock_gettime(CLOCK_MONOTONIC, &init_time);
+	if (pthread_key_create(&groups_key, pong_log_internal_freeThreadGroups)) {
+		printf("Could not create log subgroup key!\n");
+		return 1;
+	}
 	time_t now = time(NULL);
 	struct tm *time_raw = localtime(&now);
 	char *time_string = NULL;
@@ -128,15 +164,32 @@ int pong_log_internal_init(void) {
 	free(compressed_log_file_name);
 
 	mkdir(log_directory_path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-	FILE *log_file = fopen(log_file_path, "w");
+	log_file = fopen(log_file_path, "w");
+	if (!log_file) {
+		printf("Could not open log file '%s'!\n", log_file_path);
+		return 1;
+	}
 	fprintf(log_file, time_string);
-	fclose(log_file);
 
 	printf("Log file will be located at '%s'.\n", log_file_path);
 	printf("Compressed log file will be located at '%s'.\n", compressed_log_file_path);
 #endif
 
 	free(time_string);
+
+	log_queue = malloc(sizeof (struct PongLogLine) * PONG_LOG_QUEUE_CAPACITY);
+	if (!log_queue) {
+		printf("Could not allocate memory for log queue!\n");
+		return 1;
+	}
+	for (unsigned int i = 0; i < PONG_LOG_QUEUE_CAPACITY; i++)
+		atomic_init(&log_queue[i].sequence, i);
+	atomic_store(&is_writer_running, 1);
+	if (pthread_create(&log_writer_thread, NULL, pong_log_internal_writerThread, NULL)) {
+		printf("Could not start log writer thread, logging synchronously instead!\n");
+		atomic_store(&is_writer_running, 0);
+	}
+
 	return 0;
 }
 
@@ -154,31 +207,44 @@ void pong_log_internal_log_variadic(const char *message, enum PongLogUrgency urg
 		return;
 #endif
 
-	static struct timespec current_time;
+	struct timespec current_time;
 	clock_gettime(CLOCK_MONOTONIC, &current_time);
 	float time_since_init = (current_time.tv_sec - init_time.tv_sec) + ((float) (current_time.tv_nsec - init_time.tv_nsec) / NSEC_PER_SEC);
 
-	va_list args_copy;
-	va_copy(args_copy, args);
-	int formatted_message_len = vsnprintf(NULL, 0, message, args_copy) + 1;
-	va_end(args_copy);
-	char *formatted_message = malloc(sizeof (char) * formatted_message_len);
-	vsprintf(formatted_message, message, args);
-
-	int log_string_len = snprintf(NULL, 0, "%.4f %s[%s] %s%s%s\n", time_since_init, log_colors[urgency], urgency_labels[urgency], groups_string, formatted_message, log_colors[PongLogUrgencyCount]) + 1;
-	char *log_string = malloc(sizeof (char) * log_string_len);
-	sprintf(log_string, "%.4f %s[%s] %s%s%s\n", time_since_init, log_colors[urgency], urgency_labels[urgency], groups_string, formatted_message, log_colors[PongLogUrgencyCount]);
+	// Without a writer thread (not yet started or already stopped), just write the line out ourselves
+	// If cleanup is still flushing the queue, wait for it so the line comes after everything queued before it
+	atomic_fetch_add(&active_producer_count, 1);
+	if (!atomic_load(&is_writer_running)) {
+		atomic_fetch_sub(&active_producer_count, 1);
+		const struct timespec idle_time = { 0, PONG_LOG_WRITER_IDLE_NSEC };
+		while (atomic_load_explicit(&is_writer_stopping, memory_order_acquire))
+			nanosleep(&idle_time, NULL);
+		char line[PONG_LOG_LINE_MAX_LEN];
+		pong_log_internal_formatLine(line, time_since_init, urgency, message, args);
+		fputs(line, stdout);
+		if (log_file)
+			fputs(line, log_file);
+		return;
+	}
 
-	printf(log_string);
-#ifdef PONG_FILE_LOGGING
-	mkdir(log_directory_path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
-	FILE *log_file = fopen(log_file_path, "a");
-	fprintf(log_file, log_string);
-	fclose(log_file);
-#endif
+	unsigned int position;
+	struct PongLogLine *line = pong_log_internal_claimLine(&position);
+	if (!line) {
+		atomic_fetch_add_explicit(&dropped_line_count, 1, memory_order_relaxed);
+		atomic_fetch_sub(&active_producer_count, 1);
+		return;
+	}
+	line->length = pong_log_internal_formatLine(line->text, time_since_init, urgency, message, args);
+	atomic_fetch_add_explicit(&queued_line_count, 1, memory_order_relaxed);
+	atomic_store_explicit(&line->sequence, position + 1, memory_order_release);
+	atomic_fetch_sub(&active_producer_count, 1);
+}
 
-	free(formatted_message);
-	free(log_string);
+void pong_log_internal_getStats(struct PongLogStats *stats) {
+	stats->queued_count = atomic_load(&queued_line_count);
+	stats->written_count = atomic_load(&written_line_count);
+	stats->dropped_count = atomic_load(&dropped_line_count);
+	stats->truncated_count = atomic_load(&truncated_line_count);
 }
 
 void pong_log_internal_pushSubgroup(const char *group_title) {
@@ -207,6 +273,8 @@ void pong_log_internal_clearSubgroups(void) {
 }
 
 void pong_log_internal_generateGroupsString(void) {
+	if (!groups_string)
+		pthread_setspecific(groups_key, &groups_key); // any non-NULL value, so the thread's subgroups are freed when it exits
 	if (!group_titles_len) {
 		free(groups_string);
 		 groups_string = strdup("");
@@ -233,9 +301,24 @@ void pong_log_internal_generateGroupsString(void) {
 }
 
 void pong_log_internal_cleanup(void) {
+	// Stopping is set first, so a thread that finds the writer gone waits for the drain instead of writing ahead of it
+	atomic_store(&is_writer_stopping, 1);
+	if (atomic_exchange(&is_writer_running, 0)) {
+		pthread_join(log_writer_thread, NULL);
+		printf("Flushed queued log lines.\n");
+	}
+	atomic_store_explicit(&is_writer_stopping, 0, memory_order_release);
+	free(log_queue);
+	log_queue = NULL;
+	printf("Logged %lu lines asynchronously (%lu dropped, %lu truncated).\n", atomic_load(&written_line_count), atomic_load(&dropped_line_count), atomic_load(&truncated_line_count));
+
 	printf("Clearing remaining log subgroups...\n");
-	free(group_titles);
-	free(groups_string);
+	pong_log_internal_freeThreadGroups(NULL);
+
+	if (log_file) {
+		fclose(log_file);
+		log_file = NULL;
+	}
 
 #ifdef PONG_FILE_LOGGING
 	mkdir(log_directory_path, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
@@ -257,6 +340,96 @@ void pong_log_internal_cleanup(void) {
 #endif
 }
 
+// Formats a complete log line into a PONG_LOG_LINE_MAX_LEN buffer, truncating the message if needed
+static unsigned int pong_log_internal_formatLine(char *line, float time_since_init, enum PongLogUrgency urgency, const char *message, va_list args) {
+	const char *color_reset = log_colors[PongLogUrgencyCount];
+	unsigned int color_reset_len = strlen(color_reset);
+	unsigned int max_len = PONG_LOG_LINE_MAX_LEN - color_reset_len - 2; // room for colour reset, newline and null terminator
+	int len = snprintf(line, max_len, "%.4f %s[%s] %s", time_since_init, log_colors[urgency], urgency_labels[urgency], groups_string ? groups_string : "");
+	if (len < 0)
+		len = 0;
+	if (len < max_len) {
+		int message_len = vsnprintf(line + len, max_len - len, message, args);
+		if (message_len > 0)
+			len += message_len;
+	}
+	if (len >= max_len) {
+		len = max_len - 1;
+		atomic_fetch_add_explicit(&truncated_line_count, 1, memory_order_relaxed);
+	}
+	memcpy(line + len, color_reset, color_reset_len);
+	len += color_reset_len;
+	line[len++] = '\n';
+	line[len] = '\0';
+	return len;
+}
+
+// Reserves the next free slot in the log queue, or returns NULL if the queue is full
+static struct PongLogLine *pong_log_internal_claimLine(unsigned int *position) {
+	unsigned int pos = atomic_load_explicit(&log_queue_enqueue_position, memory_order_relaxed);
+	for (;;) {
+		struct PongLogLine *line = log_queue + (pos & (PONG_LOG_QUEUE_CAPACITY - 1));
+		int difference = (int) (atomic_load_explicit(&line->sequence, memory_order_acquire) - pos);
+		if (difference == 0) {
+			if (atomic_compare_exchange_weak_explicit(&log_queue_enqueue_position, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				*position = pos;
+				return line;
+			}
+		} else if (difference < 0) {
+			return NULL;
+		} else {
+			pos = atomic_load_explicit(&log_queue_enqueue_position, memory_order_relaxed);
+		}
+	}
+}
+
+// Drains the log queue in batches so each batch costs one write per output
+static void *pong_log_internal_writerThread(void *arg) {
+	static char batch[PONG_LOG_WRITER_BATCH_SIZE];
+	const struct timespec idle_time = { 0, PONG_LOG_WRITER_IDLE_NSEC };
+	for (;;) {
+		// Stopping only once no thread is still queuing a line, anything it queued is then picked up by this last drain
+		int is_stopping = atomic_load(&is_writer_stopping) && !atomic_load(&is_writer_running) && !atomic_load(&active_producer_count);
+		unsigned int batch_len = 0, batch_lines = 0;
+		for (;;) {
+			struct PongLogLine *line = log_queue + (log_queue_dequeue_position & (PONG_LOG_QUEUE_CAPACITY - 1));
+			if (atomic_load_explicit(&line->sequence, memory_order_acquire) != log_queue_dequeue_position + 1)
+				break;
+			if (batch_len + line->length > PONG_LOG_WRITER_BATCH_SIZE)
+				break;
+			memcpy(batch + batch_len, line->text, line->length);
+			batch_len += line->length;
+			batch_lines++;
+			atomic_store_explicit(&line->sequence, log_queue_dequeue_position + PONG_LOG_QUEUE_CAPACITY, memory_order_release);
+			log_queue_dequeue_position++;
+		}
+
+		if (batch_len) {
+			fwrite(batch, 1, batch_len, stdout);
+			fflush(stdout);
+			if (log_file) {
+				fwrite(batch, 1, batch_len, log_file);
+				fflush(log_file);
+			}
+			atomic_fetch_add_explicit(&written_line_count, batch_lines, memory_order_relaxed);
+		} else if (is_stopping) {
+			break;
+		} else {
+			nanosleep(&idle_time, NULL);
+		}
+	}
+	return NULL;
+}
+
+// Runs on each thread as it exits, and on the main thread from cleanup
+static void pong_log_internal_freeThreadGroups(void *arg) {
+	free(group_titles);
+	free(groups_string);
+	group_titles = NULL;
+	groups_string = NULL;
+	group_titles_len = 0;
+}
+
 #else
 
 typedef int this_is_not_an_empty_translation_unit;
@@ -1,6 +1,13 @@
 #ifndef PONG_LOG_H
 #define PONG_LOG_H
 
+struct PongLogStats {
+	unsigned long queued_count;
+	unsigned long written_count;
+	unsigned long dropped_count;
+	unsigned long truncated_count;
+};
+
 #ifdef PONG_LOGGING
 
 #include <stdarg.h>
@@ -8,6 +15,7 @@
 #define PONG_LOG_INIT() pong_log_internal_init()
 #define PONG_LOG(message, ...) pong_log_internal_log(message, __VA_ARGS__)
 #define PONG_LOG_VARIADIC(message, urgency, args) pong_log_internal_log_variadic(message, urgency, args)
+#define PONG_LOG_GET_STATS(stats) pong_log_internal_getStats(stats)
 #define PONG_LOG_CLEANUP() pong_log_internal_cleanup()
 
 #ifdef PONG_VERBOSE_LOGS
@@ -32,6 +40,7 @@ enum PongLogUrgency {
 int pong_log_internal_init(void);
 void pong_log_internal_log(const char *message, enum PongLogUrgency urgency, ...);
 void pong_log_internal_log_variadic(const char *message, enum PongLogUrgency urgency, va_list args);
+void pong_log_internal_getStats(struct PongLogStats *stats);
 void pong_log_internal_cleanup(void);
 
 #ifdef PONG_VERBOSE_LOGS
@@ -48,9 +57,36 @@ void pong_log_internal_clearSubgroups(void);
 #define PONG_LOG_SUBGROUP_START(group_title)
 #define PONG_LOG_SUBGROUP_END()
 #define PONG_LOG_CLEAR_SUBGROUPS()
+#define PONG_LOG_GET_STATS(stats) (*(stats) = (struct PongLogStats) { 0 })
 #define PONG_LOG_CLEANUP()
 
 #endif
 
+// Profiling builds also record subgroups as profiler zones, which are exported as a trace on cleanup
+#ifdef PONG_PROFILING
+#include "profiler.h"
+#undef PONG_LOG_SUBGROUP_START
+#undef PONG_LOG_SUBGROUP_END
+#undef PONG_LOG_CLEAR_SUBGROUPS
+#if defined(PONG_LOGGING) && defined(PONG_VERBOSE_LOGS)
+#define PONG_LOG_SUBGROUP_START(group_title) (pong_log_internal_pushSubgroup(group_title), pong_profiler_beginZone(group_title))
+#define PONG_LOG_SUBGROUP_END() (pong_profiler_endZone(), pong_log_internal_popSubgroup())
+#define PONG_LOG_CLEAR_SUBGROUPS() (pong_profiler_endAllZones(), pong_log_internal_clearSubgroups())
+#else
+#define PONG_LOG_SUBGROUP_START(group_title) pong_profiler_beginZone(group_title)
+#define PONG_LOG_SUBGROUP_END() pong_profiler_endZone()
+#define PONG_LOG_CLEAR_SUBGROUPS() pong_profiler_endAllZones()
+#endif
+#endif
+
+// Zones around every tick or frame only exist in profiling builds, pushing a log subgroup that often costs too much
+#ifdef PONG_PROFILING
+#define PONG_PROFILE_ZONE_START(zone_name) pong_profiler_beginZone(zone_name)
+#define PONG_PROFILE_ZONE_END() pong_profiler_endZone()
+#else
+#define PONG_PROFILE_ZONE_START(zone_name)
+#define PONG_PROFILE_ZONE_END()
+#endif
+
 #endif // PONG_LOG_H
 
@@ -0,0 +1,139 @@
+#include "lz4.h"
+#include <string.h>
+
+// Kept free of other modules so tools/pack.c can build with it and compress resources ahead of time
+// Implements the LZ4 block format: sequences of literals followed by a match copied from earlier output
+
+#define PONG_LZ4_MIN_MATCH 4
+#define PONG_LZ4_MAX_OFFSET 65535
+#define PONG_LZ4_LAST_LITERALS 5
+#define PONG_LZ4_MATCH_FIND_LIMIT 12
+#define PONG_LZ4_HASH_BITS 12
+
+static unsigned int pong_lz4_internal_read32(const unsigned char *bytes);
+static unsigned char *pong_lz4_internal_writeLength(unsigned char *destination, unsigned int length);
+
+// Greedy single-pass compressor, returns the compressed size or 0 if it doesn't fit in destination
+int pong_lz4_compress(const unsigned char *source, int source_size, unsigned char *destination, int destination_capacity) {
+	int match_table[1 << PONG_LZ4_HASH_BITS];
+	memset(match_table, -1, sizeof match_table);
+	const unsigned char *source_end = source + source_size, *input = source, *anchor = source;
+	unsigned char *output = destination, *output_end = destination + destination_capacity;
+
+	// The spec requires the final bytes to be literals, so matches are only searched for before them
+	if (source_size > PONG_LZ4_MATCH_FIND_LIMIT) {
+		const unsigned char *match_find_end = source_end - PONG_LZ4_MATCH_FIND_LIMIT, *match_extend_end = source_end - PONG_LZ4_LAST_LITERALS;
+		while (input < match_find_end) {
+			unsigned int sequence = pong_lz4_internal_read32(input);
+			unsigned int hash = (sequence * 2654435761u) >> (32 - PONG_LZ4_HASH_BITS);
+			int candidate = match_table[hash];
+			match_table[hash] = input - source;
+			if (candidate < 0 || input - source - candidate > PONG_LZ4_MAX_OFFSET || pong_lz4_internal_read32(source + candidate) != sequence) {
+				input++;
+				continue;
+			}
+
+			const unsigned char *match = source + candidate;
+			unsigned int match_length = PONG_LZ4_MIN_MATCH;
+			while (input + match_length < match_extend_end && input[match_length] == match[match_length])
+				match_length++;
+			unsigned int literal_length = input - anchor;
+			if (output_end - output < 1 + literal_length / 255 + 1 + literal_length + 2 + (match_length - PONG_LZ4_MIN_MATCH) / 255 + 1)
+				return 0;
+
+			unsigned char *token = output++;
+			*token = (literal_length < 15 ? literal_length : 15) << 4;
+			if (literal_length >= 15)
+				output = pong_lz4_internal_writeLength(output, literal_length - 15);
+			memcpy(output, anchor, literal_length);
+			output += literal_length;
+			unsigned int offset = input - match;
+			*output++ = offset & 0xff;
+			*output++ = offset >> 8;
+			unsigned int extra_match_length = match_length - PONG_LZ4_MIN_MATCH;
+			*token |= extra_match_length < 15 ? extra_match_length : 15;
+			if (extra_match_length >= 15)
+				output = pong_lz4_internal_writeLength(output, extra_match_length - 15);
+			input += match_length;
+			anchor = input;
+		}
+	}
+
+	unsigned int literal_length = source_end - anchor;
+	if (output_end - output < 1 + literal_length / 255 + 1 + literal_length)
+		return 0;
+	*output++ = (literal_length < 15 ? literal_length : 15) << 4;
+	if (literal_length >= 15)
+		output = pong_lz4_internal_writeLength(output, literal_length - 15);
+	memcpy(output, anchor, literal_length);
+	output += literal_length;
+	return output - destination;
+}
+
+// Returns the decompressed size, or -1 if the source is malformed or wouldn't fit in destination
+int pong_lz4_decompress(const unsigned char *source, int source_size, unsigned char *destination, int destination_size) {
+	const unsigned char *input = source, *input_end = source + source_size;
+	unsigned char *output = destination, *output_end = destination + destination_size;
+	while (input < input_end) {
+		unsigned int token = *input++;
+		unsigned int literal_length = token >> 4;
+		if (literal_length == 15) {
+			unsigned int length_byte;
+			do {
+				if (input == input_end)
+					return -1;
+				literal_length += length_byte = *input++;
+			} while (length_byte == 255);
+		}
+		if (literal_length > input_end - input || literal_length > output_end - output)
+			return -1;
+		memcpy(output, input, literal_length);
+		output += literal_length;
+		input += literal_length;
+		if (input == input_end)
+			break;
+
+		if (input_end - input < 2)
+			return -1;
+		unsigned int offset = input[0] | input[1] << 8;
+		input += 2;
+		if (!offset || offset > output - destination)
+			return -1;
+		unsigned int match_length = token & 15;
+		if (match_length == 15) {
+			unsigned int length_byte;
+			do {
+				if (input == input_end)
+					return -1;
+				match_length += length_byte = *input++;
+			} while (length_byte == 255);
+		}
+		match_length += PONG_LZ4_MIN_MATCH;
+		if (match_length > output_end - output)
+			return -1;
+
+		// Matches may overlap the bytes they produce to repeat a pattern, so those are copied a byte at a time
+		const unsigned char *match = output - offset;
+		if (offset >= match_length) {
+			memcpy(output, match, match_length);
+			output += match_length;
+		} else {
+			while (match_length--)
+				*output++ = *match++;
+		}
+	}
+	return output - destination;
+}
+
+static unsigned int pong_lz4_internal_read32(const unsigned char *bytes) {
+	unsigned int value;
+	memcpy(&value, bytes, sizeof value);
+	return value;
+}
+
+static unsigned char *pong_lz4_internal_writeLength(unsigned char *destination, unsigned int length) {
+	for (; length >= 255; length -= 255)
+		*destination++ = 255;
+	*destination++ = length;
+	return destination;
+}
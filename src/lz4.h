@@ -0,0 +1,9 @@
+#ifndef PONG_LZ4_H
+#define PONG_LZ4_H
+
+#define PONG_LZ4_COMPRESS_BOUND(size) ((size) + (size) / 255 + 16)
+
+int pong_lz4_compress(const unsigned char *source, int source_size, unsigned char *destination, int destination_capacity);
+int pong_lz4_decompress(const unsigned char *source, int source_size, unsigned char *destination, int destination_size);
+
+#endif // PONG_LZ4_H
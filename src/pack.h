@@ -0,0 +1,29 @@
+#ifndef PONG_PACK_H
+#define PONG_PACK_H
+
+// Layout of data.wad, written by tools/pack.c and read by resources.c, all integers are little-endian
+//
+// Header:     magic, version, entry count, name table size (4 bytes each)
+// Index:      one entry per resource, sorted by the pong_hash_string() of its path so lookups are a binary search
+//             hash, name offset, method, reserved (4 bytes each), payload offset (8 bytes), size, stored size (4 bytes each)
+// Name table: null-terminated resource paths, used to confirm a lookup matched the right path
+// Payloads:   each starts on a PONG_PACK_ALIGNMENT boundary
+//             stored payloads are the file as-is
+//             LZ4 payloads are the file split into independently compressed PONG_PACK_BLOCK_SIZE blocks,
+//             each prefixed by its 4 byte stored size with PONG_PACK_BLOCK_UNCOMPRESSED set if it didn't compress
+
+#define PONG_PACK_MAGIC 0x44415750u // "PWAD"
+#define PONG_PACK_VERSION 1
+#define PONG_PACK_ALIGNMENT 16
+#define PONG_PACK_HEADER_SIZE 16
+#define PONG_PACK_ENTRY_SIZE 32
+#define PONG_PACK_BLOCK_SIZE 65536
+#define PONG_PACK_BLOCK_HEADER_SIZE 4
+#define PONG_PACK_BLOCK_UNCOMPRESSED 0x80000000u
+
+enum PongPackMethod {
+	PONG_PACK_STORED,
+	PONG_PACK_LZ4
+};
+
+#endif // PONG_PACK_H
@@ -5,82 +5,202 @@
 #include "window.h"
 #include "resources.h"
 #include "ball.h"
+#include "timing.h"
 #include "log.h"
+#include "error.h"
+#ifdef PONG_PROFILING
+#include "profiler.h"
+#endif
 #include <time.h>
+#include <stdatomic.h>
+#ifdef PONG_HEADLESS
+#include <signal.h>
+#include <stdio.h>
+#else
+#include <pthread.h>
+#endif
 
-#define NSEC_PER_TICK NSEC_PER_SEC / 60
-#define MAX_NSEC_BEHIND NSEC_PER_SEC / 10
+#define NSEC_PER_TICK (NSEC_PER_SEC / PONG_TICKS_PER_SECOND)
+#define MAX_NSEC_BEHIND (NSEC_PER_SEC / 10)
+
+// Headless builds run until this many ticks have passed, or forever if 0
+#ifndef PONG_HEADLESS_TICK_LIMIT
+#define PONG_HEADLESS_TICK_LIMIT 0
+#endif
 
 static unsigned int pong_internal_focusCallback(int is_focused);
 static unsigned int pong_internal_quitCallback();
+#ifdef PONG_HEADLESS
+static void pong_internal_interruptHandler(int signal_number);
+#else
+static void pong_internal_stopSimulation(void);
+static void *pong_internal_simulationThread(void *arg);
+#endif
 
-static unsigned int is_running;
-static struct PongBall *ball;
+static atomic_uint is_running;
+#ifdef PONG_HEADLESS
+static volatile sig_atomic_t is_interrupted;
+#else
+static pthread_t simulation_thread;
+static unsigned int is_simulation_started;
+#endif
+static unsigned int ball = PONG_BALL_INVALID_ID;
 
 void pong_init(void) {
+	pong_error_init();
+#ifdef PONG_PROFILING
+	pong_profiler_setThreadName("Main");
+#endif
+	pong_events_setProducerName("Main");
 	PONG_LOG_SUBGROUP_START("Init");
 	PONG_LOG("Initializing game...", PONG_LOG_NOTEWORTHY);
 	pong_files_init();
+	pong_timing_init();
+	pong_events_init();
 	pong_resources_init();
+#ifndef PONG_HEADLESS
 	pong_window_init();
+#endif
 	pong_events_addCallback(PONG_EVENT_FOCUS, &pong_internal_focusCallback);
 	pong_events_addCallback(PONG_EVENT_QUIT, &pong_internal_quitCallback);
+	pong_ball_init();
 	ball = pong_ball_create();
 	PONG_LOG("Initialization complete!", PONG_LOG_INFO);
 	PONG_LOG_SUBGROUP_END();
 }
 
+#ifdef PONG_HEADLESS
 void pong_start(void) {
-	unsigned int accumulated_time;
-	struct timespec current_time, previous_time;
-	unsigned int tick_count, draw_count, current_second;
+	struct timespec start_time, end_time;
+	unsigned long tick_count;
+#ifdef PONG_HEADLESS_REALTIME
+	struct timespec next_tick_time;
+#endif
 
 	is_running = 1;
-	accumulated_time = 0;
-	clock_gettime(CLOCK_MONOTONIC, &previous_time);
-	tick_count = draw_count = 0;
-	current_second = previous_time.tv_sec;
-	PONG_LOG("Entering main game loop...", PONG_LOG_NOTEWORTHY);
+	// A stop from a thread that failed during init was just overwritten, so check for one before entering the loop
+	if (pong_error_hasThreadFailed())
+		PONG_ERROR("Stopped after an error on another thread!");
+	is_interrupted = 0;
+	tick_count = 0;
+	signal(SIGINT, pong_internal_interruptHandler);
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+#ifdef PONG_HEADLESS_REALTIME
+	next_tick_time = start_time;
+#endif
+	pong_timing_start();
+	PONG_LOG("Entering headless game loop...", PONG_LOG_NOTEWORTHY);
 	do {
-		clock_gettime(CLOCK_MONOTONIC, &current_time);
-		accumulated_time += ((current_time.tv_sec - previous_time.tv_sec) * NSEC_PER_SEC) + (current_time.tv_nsec - previous_time.tv_nsec);
-		previous_time = current_time;
-
-		if (accumulated_time > MAX_NSEC_BEHIND) {
-			PONG_LOG("Can't keep up! Skipping queued update cycles...", PONG_LOG_WARNING);
-			accumulated_time = 0;
-			pong_window_update();
-			pong_events_pollEvents();
+#ifdef PONG_HEADLESS_REALTIME
+		next_tick_time.tv_nsec += NSEC_PER_TICK;
+		if (next_tick_time.tv_nsec >= NSEC_PER_SEC) {
+			next_tick_time.tv_nsec -= NSEC_PER_SEC;
+			next_tick_time.tv_sec++;
 		}
-
-		while (accumulated_time >= NSEC_PER_TICK) {
-			accumulated_time -= NSEC_PER_TICK;
-			pong_window_update();
-			pong_ball_update(ball);
-			pong_events_pollEvents();
-			tick_count++;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_tick_time, NULL);
+#endif
+#ifdef PONG_HOT_RELOAD
+		pong_resources_reloadChanged();
+#endif
+		PONG_PROFILE_ZONE_START("Tick");
+		// Headless ticks are only timed with PONG_HEADLESS_TIMING, as the clock reads would skew benchmarks of ticks this short
+#ifdef PONG_HEADLESS_TIMING
+		unsigned long long tick_start_nsec = pong_timing_getNsec();
+#endif
+		pong_ball_update();
+#ifdef PONG_HEADLESS_TIMING
+		unsigned long long phase_nsec = pong_timing_record(PONG_TIMING_UPDATE, tick_start_nsec);
+#endif
+		tick_count++;
+		if (is_interrupted || (PONG_HEADLESS_TICK_LIMIT && tick_count >= PONG_HEADLESS_TICK_LIMIT)) {
+			is_interrupted = 0;
+			pong_events_pushQuitEvent();
 		}
+		pong_events_pollEvents();
+#ifdef PONG_HEADLESS_TIMING
+		pong_timing_record(PONG_TIMING_POLL, phase_nsec);
+		pong_timing_record(PONG_TIMING_TICK, tick_start_nsec);
+#endif
+		PONG_PROFILE_ZONE_END();
+		if (pong_timing_handleReportRequest())
+			pong_resources_report();
+	} while (is_running);
+	clock_gettime(CLOCK_MONOTONIC, &end_time);
+	PONG_LOG("Exited headless game loop!", PONG_LOG_NOTEWORTHY);
+	if (pong_error_hasThreadFailed())
+		PONG_ERROR("Stopped after an error on another thread!");
 
-		pong_ball_draw(ball);
-		pong_window_render();
-		draw_count++;
+	// Printed even without logging, as headless builds are mostly run as benchmarks
+	double elapsed_seconds = (end_time.tv_sec - start_time.tv_sec) + (double) (end_time.tv_nsec - start_time.tv_nsec) / NSEC_PER_SEC;
+	printf("Ran %lu ticks in %.3fs (%.0ftps)\n", tick_count, elapsed_seconds, elapsed_seconds > 0 ? tick_count / elapsed_seconds : 0.0);
+}
+#else
+// The simulation ticks on its own thread so render stalls (e.g. waiting on V-Sync) can't hold it up
+// This thread just polls the window and draws the latest published state
+void pong_start(void) {
+	is_running = 1;
+	// A stop from a thread that failed during init was just overwritten, so check for one before entering the loop
+	if (pong_error_hasThreadFailed())
+		PONG_ERROR("Stopped after an error on another thread!");
+	pong_timing_start();
+	PONG_LOG("Starting simulation thread...", PONG_LOG_VERBOSE);
+	if (pthread_create(&simulation_thread, NULL, pong_internal_simulationThread, NULL))
+		PONG_ERROR("Could not start simulation thread!");
+	is_simulation_started = 1;
 
-		if (current_time.tv_sec > current_second) {
-			current_second = current_time.tv_sec;
-			PONG_LOG("%itps %ifps", PONG_LOG_INFO, tick_count, draw_count);
-			tick_count = draw_count = 0;
-		}
+	PONG_LOG("Entering main game loop...", PONG_LOG_NOTEWORTHY);
+	do {
+#ifdef PONG_HOT_RELOAD
+		pong_resources_reloadChanged();
+#endif
+		PONG_PROFILE_ZONE_START("Frame");
+		unsigned long long frame_start_nsec = pong_timing_getNsec();
+		pong_window_update();
+		unsigned long long phase_nsec = pong_timing_record(PONG_TIMING_INPUT, frame_start_nsec);
+
+		// Draw the latest tick blended with the one before it by how far we are between ticks
+		unsigned long long tick_nsec = pong_ball_acquireSnapshot();
+		float alpha = phase_nsec > tick_nsec ? (float) (phase_nsec - tick_nsec) / NSEC_PER_TICK : 0.f;
+		pong_ball_draw(alpha < 1.f ? alpha : 1.f);
+		phase_nsec = pong_timing_record(PONG_TIMING_DRAW, phase_nsec);
+		pong_window_render();
+		pong_timing_record(PONG_TIMING_SWAP, phase_nsec);
+		pong_timing_record(PONG_TIMING_FRAME, frame_start_nsec);
+		PONG_PROFILE_ZONE_END();
+		if (pong_timing_handleReportRequest())
+			pong_resources_report();
 	} while (is_running);
+
+	pong_internal_stopSimulation();
 	PONG_LOG("Exited main game loop!", PONG_LOG_NOTEWORTHY);
+	if (pong_error_hasThreadFailed())
+		PONG_ERROR("Stopped after an error on another thread!");
+}
+#endif
+
+// Safe to call from any thread, the game loop finishes its current iteration first
+void pong_stop(void) {
+	is_running = 0;
 }
 
 void pong_cleanup(void) {
 	PONG_LOG_SUBGROUP_START("Clean");
 	PONG_LOG("Cleaning up...", PONG_LOG_NOTEWORTHY);
-	pong_ball_destroy(ball);
+#ifndef PONG_HEADLESS
+	pong_internal_stopSimulation();
+#endif
+	pong_timing_cleanup();
+	if (ball != PONG_BALL_INVALID_ID)
+		pong_ball_destroy(ball);
+	pong_ball_cleanup();
 	pong_events_cleanup();
+#ifndef PONG_HEADLESS
 	pong_window_cleanup();
+#endif
 	pong_resources_cleanup();
+#ifdef PONG_PROFILING
+	pong_profiler_cleanup();
+#endif
 	pong_files_cleanup();
 	PONG_LOG_SUBGROUP_END();
 }
@@ -96,3 +216,56 @@ static unsigned int pong_internal_quitCallback(void) {
 	return 1;
 }
 
+#ifdef PONG_HEADLESS
+static void pong_internal_interruptHandler(int signal_number) {
+	is_interrupted = 1;
+}
+#else
+// The simulation must have stopped before anything it uses is cleaned up, so this is called first on any exit from the main thread
+static void pong_internal_stopSimulation(void) {
+	if (!is_simulation_started)
+		return;
+	PONG_LOG("Waiting for simulation thread to stop...", PONG_LOG_VERBOSE);
+	is_running = 0;
+	pthread_join(simulation_thread, NULL);
+	is_simulation_started = 0;
+}
+
+static void *pong_internal_simulationThread(void *arg) {
+	struct timespec current_time, next_tick_time;
+#ifdef PONG_PROFILING
+	pong_profiler_setThreadName("Simulation");
+#endif
+	pong_events_setProducerName("Simulation");
+	PONG_LOG("Entering simulation loop at %itps...", PONG_LOG_NOTEWORTHY, PONG_TICKS_PER_SECOND);
+	clock_gettime(CLOCK_MONOTONIC, &next_tick_time);
+	do {
+		PONG_PROFILE_ZONE_START("Tick");
+		unsigned long long tick_nsec = (unsigned long long) next_tick_time.tv_sec * NSEC_PER_SEC + next_tick_time.tv_nsec;
+		unsigned long long tick_start_nsec = pong_timing_getNsec();
+		pong_ball_update();
+		unsigned long long phase_nsec = pong_timing_record(PONG_TIMING_UPDATE, tick_start_nsec);
+		// Events pushed after the tick was due belong to the next one, even if this tick is running late
+		pong_events_pollEventsBefore(tick_nsec);
+		pong_timing_record(PONG_TIMING_POLL, phase_nsec);
+		pong_ball_publishSnapshot(tick_nsec);
+		pong_timing_record(PONG_TIMING_TICK, tick_start_nsec);
+		PONG_PROFILE_ZONE_END();
+
+		next_tick_time.tv_nsec += NSEC_PER_TICK;
+		if (next_tick_time.tv_nsec >= NSEC_PER_SEC) {
+			next_tick_time.tv_nsec -= NSEC_PER_SEC;
+			next_tick_time.tv_sec++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &current_time);
+		long long nsec_behind = (long long) (current_time.tv_sec - next_tick_time.tv_sec) * NSEC_PER_SEC + (current_time.tv_nsec - next_tick_time.tv_nsec);
+		if (nsec_behind > MAX_NSEC_BEHIND) {
+			PONG_LOG("Can't keep up! Skipping queued update cycles...", PONG_LOG_WARNING);
+			next_tick_time = current_time;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_tick_time, NULL);
+	} while (is_running);
+	PONG_LOG("Exited simulation loop!", PONG_LOG_NOTEWORTHY);
+	return NULL;
+}
+#endif
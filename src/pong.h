@@ -3,6 +3,7 @@
 
 void pong_init(void);
 void pong_start(void);
+void pong_stop(void);
 void pong_cleanup(void);
 
 #endif // PONG_PONG_H
@@ -0,0 +1,183 @@
+#ifdef PONG_PROFILING
+
+#include "profiler.h"
+#include "core.h"
+#include "files.h"
+#include "log.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define PONG_PROFILER_INITIAL_CAPACITY 4096
+#define PONG_PROFILER_MAX_EVENTS_PER_THREAD (1u << 22)
+#define PONG_PROFILER_TRACE_FILE "trace.json"
+
+// A zone end is recorded as an event without a name
+struct PongProfilerEvent {
+	const char *name;
+	unsigned long long nsec;
+};
+
+// Every thread records into its own buffer, buffers are only shared once the threads are done
+struct PongProfilerBuffer {
+	struct PongProfilerEvent *events;
+	unsigned int length;
+	unsigned int capacity;
+	unsigned int depth;
+	unsigned int is_full;
+	unsigned int thread_id;
+	const char *thread_name;
+	struct PongProfilerBuffer *next;
+};
+
+static struct PongProfilerBuffer *pong_profiler_internal_getThreadBuffer(void);
+static void pong_profiler_internal_recordEvent(const char *name);
+static void pong_profiler_internal_writeJsonString(FILE *file, const char *string);
+
+static _Thread_local struct PongProfilerBuffer *thread_buffer;
+static struct PongProfilerBuffer *buffers;
+static pthread_mutex_t buffers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int thread_count;
+static unsigned int is_finished;
+
+void pong_profiler_beginZone(const char *zone_name) {
+	pong_profiler_internal_recordEvent(zone_name);
+}
+
+void pong_profiler_endZone(void) {
+	pong_profiler_internal_recordEvent(NULL);
+}
+
+void pong_profiler_endAllZones(void) {
+	struct PongProfilerBuffer *buffer = pong_profiler_internal_getThreadBuffer();
+	while (buffer && buffer->depth)
+		pong_profiler_internal_recordEvent(NULL);
+}
+
+void pong_profiler_setThreadName(const char *thread_name) {
+	struct PongProfilerBuffer *buffer = pong_profiler_internal_getThreadBuffer();
+	if (buffer)
+		buffer->thread_name = thread_name;
+}
+
+// Writes every recorded zone in Chrome's Trace Event format, viewable in chrome://tracing or Perfetto
+// Only call this once every other thread that recorded zones has finished
+void pong_profiler_writeTrace(const char *file_path) {
+	PONG_LOG("Writing profiler trace to '%s'...", PONG_LOG_INFO, file_path);
+	FILE *file = fopen(file_path, "w");
+	if (!file) {
+		PONG_LOG("Could not open '%s' for writing!", PONG_LOG_WARNING, file_path);
+		return;
+	}
+
+	pthread_mutex_lock(&buffers_mutex);
+	unsigned int is_first_event = 1;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (struct PongProfilerBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+		if (buffer->thread_name) {
+			fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", is_first_event ? "" : ",", buffer->thread_id);
+			pong_profiler_internal_writeJsonString(file, buffer->thread_name);
+			fprintf(file, "}}");
+			is_first_event = 0;
+		}
+		for (unsigned int i = 0; i < buffer->length; i++) {
+			const struct PongProfilerEvent *event = buffer->events + i;
+			fprintf(file, "%s\n{\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":1,\"tid\":%u", is_first_event ? "" : ",",
+				event->name ? 'B' : 'E', event->nsec / 1000, event->nsec % 1000, buffer->thread_id);
+			if (event->name) {
+				fprintf(file, ",\"name\":");
+				pong_profiler_internal_writeJsonString(file, event->name);
+			}
+			fprintf(file, "}");
+			is_first_event = 0;
+		}
+		if (buffer->is_full)
+			PONG_LOG("Thread %u ran out of room for profiler zones, its trace is cut short!", PONG_LOG_WARNING, buffer->thread_id);
+	}
+	fprintf(file, "\n]}\n");
+	pthread_mutex_unlock(&buffers_mutex);
+	fclose(file);
+}
+
+void pong_profiler_cleanup(void) {
+	const char *data_directory = pong_files_getDataDirectoryPath();
+	if (data_directory) {
+		char *trace_file_path = malloc(sizeof (char) * (strlen(data_directory) + strlen(PONG_PROFILER_TRACE_FILE) + 1));
+		if (trace_file_path) {
+			pong_profiler_writeTrace(strcat(strcpy(trace_file_path, data_directory), PONG_PROFILER_TRACE_FILE));
+			free(trace_file_path);
+		}
+	}
+
+	pthread_mutex_lock(&buffers_mutex);
+	is_finished = 1;
+	while (buffers) {
+		struct PongProfilerBuffer *next = buffers->next;
+		free(buffers->events);
+		free(buffers);
+		buffers = next;
+	}
+	thread_buffer = NULL;
+	pthread_mutex_unlock(&buffers_mutex);
+}
+
+// Creates and registers the calling thread's buffer on first use, returns NULL once profiling has finished
+static struct PongProfilerBuffer *pong_profiler_internal_getThreadBuffer(void) {
+	if (thread_buffer)
+		return thread_buffer;
+	pthread_mutex_lock(&buffers_mutex);
+	if (!is_finished) {
+		thread_buffer = calloc(1, sizeof (struct PongProfilerBuffer));
+		if (thread_buffer) {
+			thread_buffer->thread_id = ++thread_count;
+			thread_buffer->next = buffers;
+			buffers = thread_buffer;
+		}
+	}
+	pthread_mutex_unlock(&buffers_mutex);
+	return thread_buffer;
+}
+
+static void pong_profiler_internal_recordEvent(const char *name) {
+	struct PongProfilerBuffer *buffer = pong_profiler_internal_getThreadBuffer();
+	if (!buffer || buffer->is_full || (!name && !buffer->depth))
+		return;
+
+	if (buffer->length == buffer->capacity) {
+		unsigned int new_capacity = buffer->capacity ? buffer->capacity * 2 : PONG_PROFILER_INITIAL_CAPACITY;
+		struct PongProfilerEvent *new_events = new_capacity <= PONG_PROFILER_MAX_EVENTS_PER_THREAD ? realloc(buffer->events, sizeof (struct PongProfilerEvent) * new_capacity) : NULL;
+		if (!new_events) {
+			buffer->is_full = 1; // stop recording rather than leave gaps in the zone nesting
+			return;
+		}
+		buffer->events = new_events;
+		buffer->capacity = new_capacity;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	buffer->events[buffer->length++] = (struct PongProfilerEvent) { name, (unsigned long long) now.tv_sec * NSEC_PER_SEC + now.tv_nsec };
+	if (name)
+		buffer->depth++;
+	else
+		buffer->depth--;
+}
+
+static void pong_profiler_internal_writeJsonString(FILE *file, const char *string) {
+	fputc('"', file);
+	for (; *string; string++) {
+		if (*string == '"' || *string == '\\')
+			fputc('\\', file);
+		if ((unsigned char) *string >= 0x20)
+			fputc(*string, file);
+	}
+	fputc('"', file);
+}
+
+#else
+
+typedef int this_is_not_an_empty_translation_unit;
+
+#endif
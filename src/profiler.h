@@ -0,0 +1,11 @@
+#ifndef PONG_PROFILER_H
+#define PONG_PROFILER_H
+
+void pong_profiler_beginZone(const char *zone_name);
+void pong_profiler_endZone(void);
+void pong_profiler_endAllZones(void);
+void pong_profiler_setThreadName(const char *thread_name);
+void pong_profiler_writeTrace(const char *file_path);
+void pong_profiler_cleanup(void);
+
+#endif // PONG_PROFILER_H
@@ -1,27 +1,59 @@
 #include "renderer.h"
 #include "core.h"
 #include "resources.h"
+#include "resource_ids.h"
 #include "log.h"
 #include "error.h"
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 #include <cglm/cglm.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 
 #define SHADER_ERROR_MSG_BUF_SIZE 256
-
-static GLuint pong_renderer_internal_compileShader(const char *source, GLenum type);
+#define RECT_BATCH_INITIAL_CAPACITY 256
+
+struct PongRectInstance {
+	GLfloat x, y, w, h;
+	GLfloat r, g, b, a;
+};
+
+struct PongRectBatch {
+	struct PongRectInstance *instances;
+	unsigned int length;
+	unsigned int capacity;
+	unsigned int buffer_capacity;
+};
+
+static GLuint pong_renderer_internal_buildProgram(void);
+static GLuint pong_renderer_internal_compileShader(const char *source, size_t source_length, GLenum type);
 static GLuint pong_renderer_internal_linkShaders(GLuint *shader_ids, unsigned int count);
+#ifdef PONG_HOT_RELOAD
+static void pong_renderer_internal_reloadCallback(const char *resource_id);
+#endif
 #ifdef PONG_GL_DEBUG
 static void pong_renderer_internal_glDebugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam);
 #endif
 
 static GLuint program_id;
 static GLuint rect_vao_id;
+static GLuint rect_vbo_id;
+static GLuint rect_ibo_id;
+static GLuint rect_instance_vbo_id;
+static struct PongRectBatch rect_batch;
 
 void pong_renderer_init(void) {
 	PONG_LOG_SUBGROUP_START("Renderer");
 	PONG_LOG("Initializing renderer...", PONG_LOG_INFO);
 
+	// Shaders load in the background while OpenGL gets set up
+	PONG_LOG("Queuing shaders to load...", PONG_LOG_VERBOSE);
+	struct PongResourceRequest *shader_requests[] = {
+		pong_resources_loadAsync(PONG_RESOURCE_SHADERS_BASIC_VERT, PONG_RESOURCE_SHADERS_BASIC_VERT),
+		pong_resources_loadAsync(PONG_RESOURCE_SHADERS_BASIC_FRAG, PONG_RESOURCE_SHADERS_BASIC_FRAG)
+	};
+
 	int gl_version = gladLoadGL(glfwGetProcAddress);
 	if (gl_version == 0)
 		PONG_ERROR("Could not load OpenGL!");
@@ -55,42 +87,43 @@ void pong_renderer_init(void) {
 	glGenVertexArrays(1, &rect_vao_id);
 	glBindVertexArray(rect_vao_id);
 
-	GLuint rect_vbo_id;
 	glGenBuffers(1, &rect_vbo_id);
 	glBindBuffer(GL_ARRAY_BUFFER, rect_vbo_id);
 	glBufferData(GL_ARRAY_BUFFER, sizeof (GLfloat) * 2 * 4, rect_vertices, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof (GLfloat) * 2, 0);
 
-	GLuint rect_ibo_id;
 	glGenBuffers(1, &rect_ibo_id);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rect_ibo_id);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof (GLushort) * 2 * 3, rect_indices, GL_STATIC_DRAW);
 
-	PONG_LOG_SUBGROUP_START("Shaders");
-	PONG_LOG("Loading shaders...", PONG_LOG_VERBOSE);
-	pong_resources_load("res/shaders/basic.vert", "basicVertShader");
-	pong_resources_load("res/shaders/basic.frag", "basicFragShader");
+	PONG_LOG("Creating rectangle instance buffer...", PONG_LOG_VERBOSE);
+	rect_batch.capacity = RECT_BATCH_INITIAL_CAPACITY;
+	rect_batch.instances = malloc(sizeof (struct PongRectInstance) * rect_batch.capacity);
+	if (!rect_batch.instances)
+		PONG_ERROR("Could not allocate memory for rectangle batch!");
+	rect_batch.buffer_capacity = rect_batch.capacity;
+	glGenBuffers(1, &rect_instance_vbo_id);
+	glBindBuffer(GL_ARRAY_BUFFER, rect_instance_vbo_id);
+	glBufferData(GL_ARRAY_BUFFER, sizeof (struct PongRectInstance) * rect_batch.buffer_capacity, NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof (struct PongRectInstance), (void *) offsetof(struct PongRectInstance, x));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof (struct PongRectInstance), (void *) offsetof(struct PongRectInstance, r));
+	glVertexAttribDivisor(2, 1);
 
-	PONG_LOG("Compiling shaders...", PONG_LOG_VERBOSE);
-	unsigned int shader_count = 2;
-	GLuint shader_ids[shader_count];
-	shader_ids[0] = pong_renderer_internal_compileShader(pong_resources_get("basicVertShader"), GL_VERTEX_SHADER);
-	shader_ids[1] = pong_renderer_internal_compileShader(pong_resources_get("basicFragShader"), GL_FRAGMENT_SHADER);
-	pong_resources_unload("basicVertShader");
-	pong_resources_unload("basicFragShader");
-
-	PONG_LOG("Linking shaders...", PONG_LOG_VERBOSE);
-	program_id = pong_renderer_internal_linkShaders(shader_ids, shader_count);
-	glDeleteShader(shader_ids[0]);
-	glDeleteShader(shader_ids[1]);
-
-	PONG_LOG("Configuring shaders...", PONG_LOG_VERBOSE);
-	glUseProgram(program_id);
-	mat4 projection_matrix = GLM_MAT4_IDENTITY_INIT;
-	glm_ortho(-PONG_WINDOW_WIDTH / 2.f, PONG_WINDOW_WIDTH / 2.f, PONG_WINDOW_HEIGHT / 2.f, -PONG_WINDOW_HEIGHT / 2.f, 1.f, -1.f, projection_matrix);
-	GLint projection_uniform_id = glGetUniformLocation(program_id, "projection"); // TODO: should projection (set only once) be a uniform?
-	glUniformMatrix4fv(projection_uniform_id, 1, GL_FALSE, (float *) projection_matrix);
+	PONG_LOG_SUBGROUP_START("Shaders");
+	PONG_LOG("Waiting for shaders to load...", PONG_LOG_VERBOSE);
+	for (unsigned int i = 0; i < sizeof shader_requests / sizeof *shader_requests; i++)
+		pong_resources_waitForRequest(shader_requests[i]);
+
+	program_id = pong_renderer_internal_buildProgram();
+	if (!program_id)
+		PONG_ERROR("Unable to build shader program!");
+#ifdef PONG_HOT_RELOAD
+	pong_resources_addReloadCallback(pong_renderer_internal_reloadCallback);
+#endif
 	PONG_LOG_SUBGROUP_END();
 
 	PONG_LOG("Finishing OpenGL configuration...", PONG_LOG_VERBOSE);
@@ -106,21 +139,42 @@ void pong_renderer_init(void) {
 }
 
 void pong_renderer_drawrect(float x, float y, float w, float h) {
-	PONG_LOG_SUBGROUP_START("DrawRect");
-	glUseProgram(program_id);
+	pong_renderer_drawColoredRect(x, y, w, h, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+// Rectangles are only queued here, they get drawn all at once by pong_renderer_flush()
+void pong_renderer_drawColoredRect(float x, float y, float w, float h, float r, float g, float b, float a) {
+	if (rect_batch.length == rect_batch.capacity) {
+		unsigned int new_capacity = rect_batch.capacity * 2;
+		struct PongRectInstance *new_instances = realloc(rect_batch.instances, sizeof (struct PongRectInstance) * new_capacity);
+		if (!new_instances)
+			PONG_ERROR("Could not reallocate memory for rectangle batch!");
+		rect_batch.instances = new_instances;
+		rect_batch.capacity = new_capacity;
+	}
+	rect_batch.instances[rect_batch.length++] = (struct PongRectInstance) { x, y, w, h, r, g, b, a };
+}
 
-	mat4 transformation_matrix = GLM_MAT4_IDENTITY_INIT;
-	vec3 translation_vector = { x, y, 0.0f };
-	vec3 scaling_vector = { w, h, 0.0f };
-	glm_translate(transformation_matrix, translation_vector);
-	glm_scale(transformation_matrix, scaling_vector);
+void pong_renderer_flush(void) {
+	if (!rect_batch.length)
+		return;
 
-	// TODO: is there a better way of passing data to shader? uniforms vs attribs, etc
-	GLint transformation_uniform_id = glGetUniformLocation(program_id, "transformation");
-	glUniformMatrix4fv(transformation_uniform_id, 1, GL_FALSE, (float *) transformation_matrix);
+	PONG_LOG_SUBGROUP_START("Flush");
+	glBindBuffer(GL_ARRAY_BUFFER, rect_instance_vbo_id);
+	if (rect_batch.length > rect_batch.buffer_capacity) {
+		PONG_LOG("Growing rectangle instance buffer from %u to %u instances...", PONG_LOG_VERBOSE, rect_batch.buffer_capacity, rect_batch.capacity);
+		rect_batch.buffer_capacity = rect_batch.capacity;
+	}
+	// Orphan the previous frame's buffer so the driver doesn't stall waiting on it
+	glBufferData(GL_ARRAY_BUFFER, sizeof (struct PongRectInstance) * rect_batch.buffer_capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof (struct PongRectInstance) * rect_batch.length, rect_batch.instances);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+	glUseProgram(program_id);
 	glBindVertexArray(rect_vao_id);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL);
+	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, NULL, rect_batch.length);
+	glBindVertexArray(0);
+	rect_batch.length = 0;
 	PONG_LOG_SUBGROUP_END();
 }
 
@@ -133,15 +187,60 @@ void pong_renderer_clearScreen(void) {
 void pong_renderer_cleanup(void) {
 	PONG_LOG_SUBGROUP_START("Renderer");
 	PONG_LOG("Cleaning up renderer...", PONG_LOG_INFO);
+#ifdef PONG_HOT_RELOAD
+	pong_resources_removeReloadCallback(pong_renderer_internal_reloadCallback);
+#endif
 	if (program_id)
 		glDeleteProgram(program_id);
+	if (rect_vao_id) {
+		glDeleteVertexArrays(1, &rect_vao_id);
+		glDeleteBuffers(1, &rect_vbo_id);
+		glDeleteBuffers(1, &rect_ibo_id);
+		glDeleteBuffers(1, &rect_instance_vbo_id);
+	}
+	free(rect_batch.instances);
+	rect_batch = (struct PongRectBatch) { 0 };
 	PONG_LOG_SUBGROUP_END();
 }
 
-static GLuint pong_renderer_internal_compileShader(const char *source, GLenum type) {
+// Returns 0 if the shaders fail to compile or link, the reason is logged
+static GLuint pong_renderer_internal_buildProgram(void) {
+	PONG_LOG("Compiling shaders...", PONG_LOG_VERBOSE);
+	unsigned int shader_count = 2;
+	GLuint shader_ids[shader_count];
+	// Sizes are only read once acquired, a hot reloaded shader's size isn't known until it's read back in
+	const char *vertex_source = pong_resources_acquireHashed(PONG_RESOURCE_SHADERS_BASIC_VERT_HASH);
+	shader_ids[0] = pong_renderer_internal_compileShader(vertex_source, pong_resources_getSizeHashed(PONG_RESOURCE_SHADERS_BASIC_VERT_HASH), GL_VERTEX_SHADER);
+	const char *fragment_source = pong_resources_acquireHashed(PONG_RESOURCE_SHADERS_BASIC_FRAG_HASH);
+	shader_ids[1] = pong_renderer_internal_compileShader(fragment_source, pong_resources_getSizeHashed(PONG_RESOURCE_SHADERS_BASIC_FRAG_HASH), GL_FRAGMENT_SHADER);
+	pong_resources_releaseHashed(PONG_RESOURCE_SHADERS_BASIC_VERT_HASH);
+	pong_resources_releaseHashed(PONG_RESOURCE_SHADERS_BASIC_FRAG_HASH);
+
+	GLuint new_program_id = 0;
+	if (shader_ids[0] && shader_ids[1]) {
+		PONG_LOG("Linking shaders...", PONG_LOG_VERBOSE);
+		new_program_id = pong_renderer_internal_linkShaders(shader_ids, shader_count);
+	}
+	glDeleteShader(shader_ids[0]);
+	glDeleteShader(shader_ids[1]);
+	if (!new_program_id)
+		return 0;
+
+	PONG_LOG("Configuring shaders...", PONG_LOG_VERBOSE);
+	glUseProgram(new_program_id);
+	mat4 projection_matrix = GLM_MAT4_IDENTITY_INIT;
+	glm_ortho(-PONG_WINDOW_WIDTH / 2.f, PONG_WINDOW_WIDTH / 2.f, PONG_WINDOW_HEIGHT / 2.f, -PONG_WINDOW_HEIGHT / 2.f, 1.f, -1.f, projection_matrix);
+	GLint projection_uniform_id = glGetUniformLocation(new_program_id, "projection"); // TODO: should projection (set only once) be a uniform?
+	glUniformMatrix4fv(projection_uniform_id, 1, GL_FALSE, (float *) projection_matrix);
+	glUseProgram(0);
+	return new_program_id;
+}
+
+static GLuint pong_renderer_internal_compileShader(const char *source, size_t source_length, GLenum type) {
 	PONG_LOG("Compiling shader...", PONG_LOG_VERBOSE);
 	GLuint shader_id = glCreateShader(type);
-	glShaderSource(shader_id, 1, &source, NULL);
+	GLint length = source_length;
+	glShaderSource(shader_id, 1, &source, &length);
 	glCompileShader(shader_id);
 
 	GLint compiled_status;
@@ -149,7 +248,9 @@ static GLuint pong_renderer_internal_compileShader(const char *source, GLenum ty
 	if (compiled_status != GL_TRUE) {
 		GLchar message[SHADER_ERROR_MSG_BUF_SIZE];
 		glGetShaderInfoLog(shader_id, SHADER_ERROR_MSG_BUF_SIZE, NULL, message);
-		PONG_ERROR("Unable to compile shader: %s", message);
+		PONG_LOG("Unable to compile shader: %s", PONG_LOG_ERROR, message);
+		glDeleteShader(shader_id);
+		return 0;
 	}
 
 	return shader_id;
@@ -166,13 +267,34 @@ static GLuint pong_renderer_internal_linkShaders(GLuint *shader_ids, unsigned in
 	glGetProgramiv(program_id, GL_LINK_STATUS, &linked_status);
 	if (linked_status != GL_TRUE) {
 		GLchar message[SHADER_ERROR_MSG_BUF_SIZE];
-		glGetShaderInfoLog(program_id, SHADER_ERROR_MSG_BUF_SIZE, NULL, message);
-		PONG_ERROR("Unable to link shaders: %s", message);
+		glGetProgramInfoLog(program_id, SHADER_ERROR_MSG_BUF_SIZE, NULL, message);
+		PONG_LOG("Unable to link shaders: %s", PONG_LOG_ERROR, message);
+		glDeleteProgram(program_id);
+		return 0;
 	}
 
 	return program_id;
 }
 
+#ifdef PONG_HOT_RELOAD
+// A broken edit shouldn't end the session, so the previous program is kept until the shaders build again
+static void pong_renderer_internal_reloadCallback(const char *resource_id) {
+	if (strcmp(resource_id, PONG_RESOURCE_SHADERS_BASIC_VERT) && strcmp(resource_id, PONG_RESOURCE_SHADERS_BASIC_FRAG))
+		return;
+	PONG_LOG_SUBGROUP_START("Shaders");
+	PONG_LOG("Rebuilding shaders...", PONG_LOG_INFO);
+	GLuint new_program_id = pong_renderer_internal_buildProgram();
+	if (new_program_id) {
+		glDeleteProgram(program_id);
+		program_id = new_program_id;
+		PONG_LOG("Shaders rebuilt!", PONG_LOG_INFO);
+	} else {
+		PONG_LOG("Keeping previous shaders until these build.", PONG_LOG_WARNING);
+	}
+	PONG_LOG_SUBGROUP_END();
+}
+#endif
+
 #ifdef PONG_GL_DEBUG
 static void pong_renderer_internal_glDebugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
 	enum PongLogUrgency urgency = PONG_LOG_VERBOSE;
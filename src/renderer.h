@@ -3,6 +3,8 @@
 
 void pong_renderer_init(void);
 void pong_renderer_drawrect(float x, float y, float w, float h);
+void pong_renderer_drawColoredRect(float x, float y, float w, float h, float r, float g, float b, float a);
+void pong_renderer_flush(void);
 void pong_renderer_clearScreen(void);
 void pong_renderer_cleanup(void);
 
@@ -3,28 +3,242 @@
 #include "files.h"
 #include "log.h"
 #include "error.h"
-#include <zip.h>
+#include "hashmap.h"
+#include "hash.h"
+#include "pack.h"
+#include "lz4.h"
+#ifdef PONG_HOT_RELOAD
+#include "watcher.h"
+#endif
+#ifdef PONG_RESOURCES_PROFILING
+#include "timing.h"
+#endif
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
-#define PONG_RESOURCES_MAP_TABLE_INITIAL_BUCKET_COUNT 8
-#define PONG_RESOURCES_MAP_TABLE_MAX_USED_BUCKETS_RATIO 0.8f
+#define PONG_RESOURCES_REQUEST_ERROR_MSG_BUF_SIZE 256
+#define PONG_RESOURCES_LOOSE_PATH_BUF_SIZE 1024
+#define PONG_RESOURCES_RELOAD_IDS_INITIAL_CAPACITY 16
 
-struct PongResourceMap {
-	const char *key;
-	void *data;
+// Matches the archive's block size, so each chunk of a compressed resource is exactly one block
+#define PONG_RESOURCES_STREAM_CHUNK_SIZE PONG_PACK_BLOCK_SIZE
+
+// Number of background threads serving pong_resources_loadAsync()
+#ifndef PONG_RESOURCES_WORKER_COUNT
+#define PONG_RESOURCES_WORKER_COUNT 2
+#endif
+
+// Bytes of decompressed resources kept resident before unreferenced ones start being evicted
+#ifndef PONG_RESOURCES_BUDGET
+#define PONG_RESOURCES_BUDGET (64 * 1024 * 1024)
+#endif
+
+// Where loose resource files are read from and watched in development builds, the Makefile points it at the project root
+#ifndef PONG_HOT_RELOAD_ROOT
+#define PONG_HOT_RELOAD_ROOT ""
+#endif
+#define PONG_HOT_RELOAD_DIRECTORY "res"
+
+#ifdef PONG_RESOURCES_PROFILING
+#ifndef PONG_LOGGING
+#error PONG_RESOURCES_PROFILING needs PONG_LOGGING to report its results!
+#endif
+#endif
+
+// An archive entry as read from the pack index, kept sorted by hash
+struct PongResourceEntry {
+	unsigned int hash;
+	enum PongPackMethod method;
+	const char *path;
+	const unsigned char *payload;
+	size_t size;
+	size_t stored_size;
+};
+
+// Resources stored uncompressed in the archive point straight into its mapping rather than owning a copy
+struct PongResource {
+	const void *data;
+	size_t size;
+	unsigned int is_mapped;
+#ifdef PONG_RESOURCES_PROFILING
+	// Filled in by whichever thread read the resource, only recorded once it's admitted on the main thread
+	unsigned long long find_nsec;
+	unsigned long long read_nsec;
+	size_t stored_size;
+#endif
+};
+
+#ifdef PONG_RESOURCES_PROFILING
+// Kept per resource ID for the whole run, so they carry on through evictions, unloads and loading it again
+// Probe lengths are how many hash map slots each lookup had to check
+struct PongResourceStats {
+	char *resource_id;
+	char *file_path;
+	unsigned int load_count;
+	unsigned int evict_count;
+	unsigned int unload_count;
+	unsigned long lookup_count;
+	unsigned long long total_probe_length;
+	unsigned int max_probe_length;
+	unsigned long long find_nsec;
+	unsigned long long read_nsec;
+	size_t stored_size;
+	size_t size;
+};
+#endif
+
+// Registered resources remember their path so they can be evicted and read back in when next needed
+// Unreferenced resident copies sit in the LRU list, most recently used first
+struct PongCachedResource {
+	const char *file_path;
+	const char *resource_id;
+	struct PongResource resource;
+	unsigned int is_resident;
+	unsigned int reference_count;
+	struct PongCachedResource *lru_prev;
+	struct PongCachedResource *lru_next;
+#ifdef PONG_RESOURCES_PROFILING
+	struct PongResourceStats *stats;
+#endif
+};
+
+enum PongResourceRequestState {
+	PONG_RESOURCES_REQUEST_QUEUED,
+	PONG_RESOURCES_REQUEST_LOADED,
+	PONG_RESOURCES_REQUEST_FAILED
+};
+
+// Workers only fill in the loaded resource, it's mapped by whoever polls or waits on the request
+struct PongResourceRequest {
+	const char *file_path;
+	const char *resource_id;
+	enum PongResourceRequestState state;
+	struct PongResource loaded_resource;
+	char error_message[PONG_RESOURCES_REQUEST_ERROR_MSG_BUF_SIZE];
+	struct PongResourceRequest *next_queued;
+	struct PongResourceRequest *next_outstanding;
+};
+
+// One independently compressed block of an LZ4 entry, so a single large entry can be split across threads too
+struct PongResourceBlock {
+	const unsigned char *source;
+	size_t source_size;
+	unsigned char *destination;
+	size_t size;
+	unsigned int is_compressed;
+	const char *error_message;
+#ifdef PONG_RESOURCES_PROFILING
+	unsigned long long nsec;
+#endif
+};
+
+struct PongResourceBatchItem {
+	struct PongResource loaded_resource;
+	const char *error_message;
+	unsigned int first_block;
+	unsigned int block_count;
+#ifdef PONG_RESOURCES_PROFILING
+	unsigned long long find_nsec;
+	unsigned long long read_nsec;
+	size_t stored_size;
+#endif
+};
+
+// Blocks are claimed one at a time by whichever thread gets to them first, the loading thread included
+// Workers only touch the batch while active_worker_count says so, which the loading thread waits on before freeing it
+struct PongResourceBatch {
+	struct PongResourceBlock *blocks;
+	unsigned int block_count;
+	atomic_uint next_block;
+	unsigned int active_worker_count;
 };
 
-static unsigned int pong_resources_internal_getHashIndex(const char *key);
-static struct PongResourceMap *pong_resources_internal_getResourceMap(const char *key);
-static struct PongResourceMap *pong_resources_internal_getEmptyResourceMap(const char *key);
-static void pong_resources_internal_deleteResourceMap(struct PongResourceMap *map);
-static void pong_resources_internal_setBucketCount(unsigned int new_bucket_count);
+// Compressed resources are decompressed a block at a time into the buffer, stored ones are handed out in place
+struct PongResourceStream {
+	const char *file_path;
+	const struct PongResourceEntry *entry;
+	const unsigned char *cursor;
+	size_t offset;
+	size_t size;
+	unsigned char *buffer;
+#ifdef PONG_HOT_RELOAD
+	FILE *loose_file;
+#endif
+};
+
+struct PongResourceWorker {
+	pthread_t thread;
+	unsigned int is_running;
+};
 
-static struct zip *zip_archive;
-static struct PongResourceMap *resource_map_table;
-static unsigned int resource_map_table_bucket_count;
-static unsigned int resource_map_table_used_bucket_count;
+static struct PongCachedResource *pong_resources_internal_getResource(const char *resource_id);
+static struct PongCachedResource *pong_resources_internal_getHashedResource(unsigned int resource_hash);
+static const void *pong_resources_internal_acquireResource(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_releaseResource(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_makeResident(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_admitResource(struct PongCachedResource *cached_resource, struct PongResource loaded_resource);
+static void pong_resources_internal_touchResource(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_evictResource(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_evictToFit(size_t incoming_size);
+static void pong_resources_internal_linkLRU(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_unlinkLRU(struct PongCachedResource *cached_resource);
+static void pong_resources_internal_indexArchive(void);
+static const struct PongResourceEntry *pong_resources_internal_findEntry(const char *file_path);
+static const char *pong_resources_internal_readResource(const char *file_path, struct PongResource *loaded_resource);
+static const char *pong_resources_internal_readEntry(const struct PongResourceEntry *entry, struct PongResource *loaded_resource);
+static const char *pong_resources_internal_decompressEntry(const struct PongResourceEntry *entry, unsigned char *data);
+static const char *pong_resources_internal_readBlockHeader(const struct PongResourceEntry *entry, const unsigned char **cursor, size_t offset, unsigned char *destination, struct PongResourceBlock *block);
+static const char *pong_resources_internal_decompressBlock(const struct PongResourceBlock *block);
+static _Noreturn void pong_resources_internal_failStream(struct PongResourceStream *stream, const char *file_path, const char *error_message);
+static void pong_resources_internal_decompressBatchBlocks(struct PongResourceBatch *batch);
+static unsigned int pong_resources_internal_hasUnclaimedBlocks(struct PongResourceBatch *batch);
+#ifdef PONG_HOT_RELOAD
+static FILE *pong_resources_internal_openLooseFile(const char *file_path);
+static const char *pong_resources_internal_readLooseFile(FILE *file, struct PongResource *loaded_resource);
+#endif
+static void pong_resources_internal_mapResource(const char *file_path, const char *resource_id, struct PongResource loaded_resource);
+static void pong_resources_internal_finishRequest(struct PongResourceRequest *request);
+static void *pong_resources_internal_workerThread(void *arg);
+static unsigned int pong_resources_internal_readU32(const unsigned char *bytes);
+static unsigned long long pong_resources_internal_readU64(const unsigned char *bytes);
+#ifdef PONG_RESOURCES_PROFILING
+static struct PongResourceStats *pong_resources_internal_getStats(const char *file_path, const char *resource_id);
+static void pong_resources_internal_recordLookup(struct PongCachedResource **mapped_resource);
+static void pong_resources_internal_recordLoad(struct PongResourceStats *stats, struct PongResource loaded_resource);
+static int pong_resources_internal_compareStats(const void *a, const void *b);
+#endif
+
+static const unsigned char *archive_data;
+static size_t archive_size;
+static struct PongResourceEntry *archive_entries;
+static unsigned int archive_entry_count;
+static struct PongHashMap resource_map;
+static struct PongCachedResource *resource_lru_head;
+static struct PongCachedResource *resource_lru_tail;
+static size_t resource_budget = PONG_RESOURCES_BUDGET;
+static size_t resident_size;
+static size_t peak_resident_size;
+#ifdef PONG_HOT_RELOAD
+static PongResourceReloadCallback *reload_callbacks;
+static unsigned int reload_callback_count;
+static const char **changed_resource_ids;
+static unsigned int changed_resource_capacity;
+#endif
+static struct PongResourceWorker resource_workers[PONG_RESOURCES_WORKER_COUNT];
+static pthread_mutex_t resource_requests_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resource_requests_queued_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t resource_requests_done_cond = PTHREAD_COND_INITIALIZER;
+static struct PongResourceRequest *resource_requests_queue_head;
+static struct PongResourceRequest *resource_requests_queue_tail;
+static struct PongResourceRequest *resource_requests_outstanding;
+static unsigned int are_resource_workers_stopping;
+static struct PongResourceBatch *active_resource_batch;
+#ifdef PONG_RESOURCES_PROFILING
+static struct PongHashMap resource_stats_map;
+#endif
 
 void pong_resources_init(void) {
 	PONG_LOG_SUBGROUP_START("Resources");
@@ -37,167 +251,1021 @@ void pong_resources_init(void) {
 	strcat(strcpy(resources_filepath, data_directory), PONG_RESOURCES_FILE);
 
 	PONG_LOG("Opening resource data archive at '%s'...", PONG_LOG_VERBOSE, resources_filepath);
-	int err = 0;
-	zip_archive = zip_open(resources_filepath, 0, &err);
+	archive_data = pong_files_mapFile(resources_filepath, &archive_size);
 	free(resources_filepath);
-	if (err) {
-		struct zip_error error;
-		zip_error_init_with_code(&error, err);
-		PONG_ERROR("An error occurred while trying to open resource data archive: %s", zip_error_strerror(&error));
-	}
+	pong_resources_internal_indexArchive();
+#ifdef PONG_HOT_RELOAD
+	pong_watcher_init(PONG_HOT_RELOAD_ROOT, PONG_HOT_RELOAD_DIRECTORY);
+#endif
+
+	PONG_LOG("Initializing resource map...", PONG_LOG_VERBOSE);
+	pong_hashmap_init(&resource_map, sizeof (struct PongCachedResource *));
+#ifdef PONG_RESOURCES_PROFILING
+	pong_hashmap_init(&resource_stats_map, sizeof (struct PongResourceStats *));
+#endif
+#ifdef PONG_HASHMAP_BENCHMARK
+	pong_hashmap_runBenchmark();
+#endif
 
-	PONG_LOG("Initializing resource map table...", PONG_LOG_VERBOSE);
-	resource_map_table_bucket_count = PONG_RESOURCES_MAP_TABLE_INITIAL_BUCKET_COUNT;
-	resource_map_table = calloc(1, sizeof (struct PongResourceMap) * resource_map_table_bucket_count);
-	if (!resource_map_table)
-		PONG_ERROR("Could not allocate memory for resource map!");
+	PONG_LOG("Starting %i resource loading workers...", PONG_LOG_VERBOSE, PONG_RESOURCES_WORKER_COUNT);
+	are_resource_workers_stopping = 0;
+	for (unsigned int i = 0; i < PONG_RESOURCES_WORKER_COUNT; i++) {
+		if (pthread_create(&resource_workers[i].thread, NULL, pong_resources_internal_workerThread, NULL))
+			PONG_ERROR("Could not start resource loading worker!");
+		resource_workers[i].is_running = 1;
+	}
 
 	PONG_LOG("Resource manager initialized!", PONG_LOG_VERBOSE);
 	PONG_LOG_SUBGROUP_END();
 }
 
+// The path is kept to reload the resource after eviction, so like the ID it must outlive the resource
 void pong_resources_load(const char *file_path, const char *resource_id) {
 	PONG_LOG_SUBGROUP_START("ResourceLoad");
 	PONG_LOG("Loading resource at '%s' as '%s'...", PONG_LOG_INFO, file_path, resource_id);
+	struct PongResource loaded_resource;
+	const char *error_message = pong_resources_internal_readResource(file_path, &loaded_resource);
+	if (error_message)
+		PONG_ERROR("An error occurred while trying to load requested resource '%s': %s", file_path, error_message);
+	pong_resources_internal_mapResource(file_path, resource_id, loaded_resource);
+	PONG_LOG("Resource '%s' successfully loaded and mapped to '%s'...", PONG_LOG_VERBOSE, file_path, resource_id);
+	PONG_LOG_SUBGROUP_END();
+}
 
-	PONG_LOG("Querying resource...", PONG_LOG_VERBOSE);
-	struct zip_stat stat;
-	zip_stat_init(&stat);
-	if (zip_stat(zip_archive, file_path, 0, &stat))
-		PONG_ERROR("An error occurred while trying to query requested resource '%s': %s", file_path, zip_strerror(zip_archive));
+// Queues the resource to be loaded in the background, it can be used once the request is ready
+// Requests are freed as soon as pong_resources_isRequestReady() or pong_resources_waitForRequest() sees them ready
+struct PongResourceRequest *pong_resources_loadAsync(const char *file_path, const char *resource_id) {
+	PONG_LOG("Queuing resource at '%s' to load as '%s'...", PONG_LOG_VERBOSE, file_path, resource_id);
+	struct PongResourceRequest *request = calloc(1, sizeof (struct PongResourceRequest));
+	if (!request)
+		PONG_ERROR("Could not allocate memory for resource request!");
+	request->file_path = file_path;
+	request->resource_id = resource_id;
+	request->state = PONG_RESOURCES_REQUEST_QUEUED;
+	pthread_mutex_lock(&resource_requests_mutex);
+	if (resource_requests_queue_tail)
+		resource_requests_queue_tail->next_queued = request;
+	else
+		resource_requests_queue_head = request;
+	resource_requests_queue_tail = request;
+	request->next_outstanding = resource_requests_outstanding;
+	resource_requests_outstanding = request;
+	pthread_cond_signal(&resource_requests_queued_cond);
+	pthread_mutex_unlock(&resource_requests_mutex);
+	return request;
+}
 
-	PONG_LOG("Opening resource...", PONG_LOG_VERBOSE);
-	char *data = malloc(sizeof (char) * stat.size + 1);
-	if (!data)
-		PONG_ERROR("Could not allocate memory for resource!");
-	struct zip_file *file = zip_fopen(zip_archive, file_path, 0);
-	if (!file) {
-		zip_fclose(file);
-		free(data);
-		PONG_ERROR("An error occurred while trying to open requested resource '%s': %s", file_path, zip_strerror(zip_archive));
+// Loads every resource before returning, with the same result as calling pong_resources_load() on each in order
+// Compressed blocks are decompressed by the workers and this thread together, rather than one resource at a time
+void pong_resources_loadBatch(const char *const *file_paths, const char *const *resource_ids, unsigned int count) {
+	PONG_LOG_SUBGROUP_START("ResourceBatch");
+	PONG_LOG("Loading batch of %u resources...", PONG_LOG_INFO, count);
+	struct PongResourceBatchItem *items = calloc(count ? count : 1, sizeof (struct PongResourceBatchItem));
+	if (!items)
+		PONG_ERROR("Could not allocate memory for resource batch!");
+
+	// Stored and loose resources are ready straight away, only compressed ones need their blocks worked out
+	struct PongResourceBatch batch = { 0 };
+	size_t block_capacity = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		struct PongResourceBatchItem *item = items + i;
+#ifdef PONG_RESOURCES_PROFILING
+		unsigned long long start_nsec = pong_timing_getNsec();
+#endif
+#ifdef PONG_HOT_RELOAD
+		FILE *loose_file = pong_resources_internal_openLooseFile(file_paths[i]);
+		if (loose_file) {
+			item->error_message = pong_resources_internal_readLooseFile(loose_file, &item->loaded_resource);
+#ifdef PONG_RESOURCES_PROFILING
+			item->read_nsec = pong_timing_getNsec() - start_nsec;
+			item->stored_size = item->loaded_resource.size;
+#endif
+			continue;
+		}
+#endif
+		const struct PongResourceEntry *entry = pong_resources_internal_findEntry(file_paths[i]);
+		if (!entry) {
+			item->error_message = "No such resource in the archive!";
+			continue;
+		}
+#ifdef PONG_RESOURCES_PROFILING
+		item->find_nsec = pong_timing_getNsec() - start_nsec;
+		item->stored_size = entry->stored_size;
+#endif
+		if (entry->method == PONG_PACK_STORED) {
+			item->loaded_resource = (struct PongResource) { entry->payload, entry->size, 1 };
+			continue;
+		}
+
+		unsigned char *data = malloc(sizeof (unsigned char) * entry->size + 1);
+		if (!data) {
+			item->error_message = "Could not allocate memory for resource!";
+			continue;
+		}
+		data[entry->size] = '\0';
+		item->loaded_resource = (struct PongResource) { data, entry->size, 0 };
+		item->first_block = batch.block_count;
+		item->block_count = (entry->size + PONG_PACK_BLOCK_SIZE - 1) / PONG_PACK_BLOCK_SIZE;
+		if (batch.block_count + item->block_count > block_capacity) {
+			size_t new_block_capacity = block_capacity ? block_capacity * 2 : 64;
+			while (new_block_capacity < batch.block_count + item->block_count)
+				new_block_capacity *= 2;
+			struct PongResourceBlock *new_blocks = realloc(batch.blocks, sizeof (struct PongResourceBlock) * new_block_capacity);
+			if (!new_blocks) {
+				item->error_message = "Could not reallocate memory for resource batch blocks!";
+				item->block_count = 0;
+				continue;
+			}
+			batch.blocks = new_blocks;
+			block_capacity = new_block_capacity;
+		}
+		const unsigned char *cursor = entry->payload;
+		for (unsigned int j = 0; !item->error_message && j < item->block_count; j++)
+			item->error_message = pong_resources_internal_readBlockHeader(entry, &cursor, (size_t) j * PONG_PACK_BLOCK_SIZE, data + (size_t) j * PONG_PACK_BLOCK_SIZE, batch.blocks + batch.block_count + j);
+		if (!item->error_message)
+			batch.block_count += item->block_count;
+		else
+			item->block_count = 0;
 	}
 
-	PONG_LOG("Reading resource...", PONG_LOG_VERBOSE);
-	zip_int64_t bytes_read;
-	zip_int64_t bytes_remaining = stat.size;
-	do {
-		bytes_read = zip_fread(file, data, stat.size);
-		if (bytes_read == -1)
-			PONG_ERROR("An error occurred while trying to load requested resource '%s': %s", file_path, zip_strerror(zip_archive));
-	} while (bytes_remaining -= bytes_read);
-	zip_fclose(file);
-	data[stat.size] = '\0';
+	PONG_LOG("Decompressing %u blocks across %i workers...", PONG_LOG_VERBOSE, batch.block_count, PONG_RESOURCES_WORKER_COUNT);
+	atomic_init(&batch.next_block, 0);
+	pthread_mutex_lock(&resource_requests_mutex);
+	active_resource_batch = &batch;
+	pthread_cond_broadcast(&resource_requests_queued_cond);
+	pthread_mutex_unlock(&resource_requests_mutex);
+	pong_resources_internal_decompressBatchBlocks(&batch);
+	pthread_mutex_lock(&resource_requests_mutex);
+	active_resource_batch = NULL;
+	while (batch.active_worker_count)
+		pthread_cond_wait(&resource_requests_done_cond, &resource_requests_mutex);
+	pthread_mutex_unlock(&resource_requests_mutex);
 
-	PONG_LOG("Mapping resource...", PONG_LOG_VERBOSE);
-	struct PongResourceMap *resource_map = pong_resources_internal_getEmptyResourceMap(resource_id);
-	*resource_map = (struct PongResourceMap) { resource_id, data };
-	resource_map_table_used_bucket_count++;
-	
-	PONG_LOG("Resource '%s' successfully loaded and mapped to '%s'...", PONG_LOG_VERBOSE, file_path, resource_id);
+	// Errors are raised for the first failed resource in the order given, like loading them one by one would
+	const char *error_message = NULL;
+	unsigned int failed_index;
+	for (failed_index = 0; failed_index < count && !error_message; failed_index++) {
+		error_message = items[failed_index].error_message;
+		for (unsigned int j = 0; !error_message && j < items[failed_index].block_count; j++)
+			error_message = batch.blocks[items[failed_index].first_block + j].error_message;
+	}
+	if (error_message) {
+		for (unsigned int i = 0; i < count; i++)
+			if (!items[i].loaded_resource.is_mapped)
+				free((void *) items[i].loaded_resource.data);
+		free(items);
+		free(batch.blocks);
+		PONG_ERROR("An error occurred while trying to load requested resource '%s': %s", file_paths[failed_index - 1], error_message);
+	}
 
-	if (resource_map_table_used_bucket_count >= resource_map_table_bucket_count * PONG_RESOURCES_MAP_TABLE_MAX_USED_BUCKETS_RATIO) {
-		PONG_LOG("Resource map tree is over-encumbered (%i/%i buckets used), doubling bucket count...", PONG_LOG_WARNING, resource_map_table_used_bucket_count, resource_map_table_bucket_count);
-		pong_resources_internal_setBucketCount(resource_map_table_bucket_count * 2);
+	PONG_LOG("Mapping batch of resources...", PONG_LOG_VERBOSE);
+	for (unsigned int i = 0; i < count; i++) {
+#ifdef PONG_RESOURCES_PROFILING
+		// Blocks are timed on whichever thread decompressed them, so this is CPU time rather than how long the batch waited
+		for (unsigned int j = 0; j < items[i].block_count; j++)
+			items[i].read_nsec += batch.blocks[items[i].first_block + j].nsec;
+		items[i].loaded_resource.find_nsec = items[i].find_nsec;
+		items[i].loaded_resource.read_nsec = items[i].read_nsec;
+		items[i].loaded_resource.stored_size = items[i].stored_size;
+#endif
+		pong_resources_internal_mapResource(file_paths[i], resource_ids[i], items[i].loaded_resource);
 	}
+	free(items);
+	free(batch.blocks);
+	PONG_LOG("Batch of %u resources successfully loaded and mapped!", PONG_LOG_VERBOSE, count);
+	PONG_LOG_SUBGROUP_END();
+}
 
+// Streams hand out a resource PONG_RESOURCES_STREAM_CHUNK_SIZE bytes at a time without ever holding all of it
+// They read straight from the archive rather than the resource map, so they can be used from any thread
+// Every stream must be closed before the resource manager is cleaned up
+struct PongResourceStream *pong_resources_openStream(const char *file_path) {
+	PONG_LOG_SUBGROUP_START("ResourceStream");
+	PONG_LOG("Opening stream of resource at '%s'...", PONG_LOG_VERBOSE, file_path);
+	struct PongResourceStream *stream = calloc(1, sizeof (struct PongResourceStream));
+	if (!stream)
+		PONG_ERROR("Could not allocate memory for resource stream!");
+	stream->file_path = file_path;
+#ifdef PONG_HOT_RELOAD
+	stream->loose_file = pong_resources_internal_openLooseFile(file_path);
+	if (stream->loose_file) {
+		long file_size = -1;
+		if (!fseek(stream->loose_file, 0, SEEK_END))
+			file_size = ftell(stream->loose_file);
+		if (file_size < 0 || fseek(stream->loose_file, 0, SEEK_SET))
+			pong_resources_internal_failStream(stream, file_path, "Could not get size of loose resource file!");
+		stream->size = file_size;
+	} else
+#endif
+	{
+		stream->entry = pong_resources_internal_findEntry(file_path);
+		if (!stream->entry)
+			pong_resources_internal_failStream(stream, file_path, "No such resource in the archive!");
+		stream->size = stream->entry->size;
+		stream->cursor = stream->entry->payload;
+	}
+
+	// Stored resources are handed out straight from the mapping, so only need a buffer to decompress or read into
+	if (!stream->entry || stream->entry->method != PONG_PACK_STORED) {
+		stream->buffer = malloc(sizeof (unsigned char) * PONG_RESOURCES_STREAM_CHUNK_SIZE);
+		if (!stream->buffer)
+			pong_resources_internal_failStream(stream, file_path, "Could not allocate memory for resource stream buffer!");
+	}
 	PONG_LOG_SUBGROUP_END();
+	return stream;
+}
+
+// Returns the next chunk and sets chunk_size to its length, or returns NULL once the whole resource has been read
+// Chunks are only valid until the next read from or closing of the stream
+const void *pong_resources_readStream(struct PongResourceStream *stream, size_t *chunk_size) {
+	if (stream->offset >= stream->size)
+		return NULL;
+	size_t offset = stream->offset;
+	*chunk_size = stream->size - offset < PONG_RESOURCES_STREAM_CHUNK_SIZE ? stream->size - offset : PONG_RESOURCES_STREAM_CHUNK_SIZE;
+	stream->offset += *chunk_size;
+
+#ifdef PONG_HOT_RELOAD
+	if (stream->loose_file) {
+		if (fread(stream->buffer, 1, *chunk_size, stream->loose_file) != *chunk_size)
+			pong_resources_internal_failStream(stream, stream->file_path, "Could not read loose resource file!");
+		return stream->buffer;
+	}
+#endif
+	if (stream->entry->method == PONG_PACK_STORED)
+		return stream->entry->payload + offset;
+
+	struct PongResourceBlock block;
+	const char *error_message = pong_resources_internal_readBlockHeader(stream->entry, &stream->cursor, offset, stream->buffer, &block);
+	if (!error_message)
+		error_message = pong_resources_internal_decompressBlock(&block);
+	if (error_message)
+		pong_resources_internal_failStream(stream, stream->file_path, error_message);
+	return stream->buffer;
+}
+
+size_t pong_resources_getStreamSize(const struct PongResourceStream *stream) {
+	return stream->size;
+}
+
+void pong_resources_closeStream(struct PongResourceStream *stream) {
+#ifdef PONG_HOT_RELOAD
+	if (stream->loose_file)
+		fclose(stream->loose_file);
+#endif
+	free(stream->buffer);
+	free(stream);
 }
 
+// Returns 1 and maps the resource once it has loaded, without blocking
+unsigned int pong_resources_isRequestReady(struct PongResourceRequest *request) {
+	pthread_mutex_lock(&resource_requests_mutex);
+	unsigned int is_ready = request->state != PONG_RESOURCES_REQUEST_QUEUED;
+	pthread_mutex_unlock(&resource_requests_mutex);
+	if (is_ready)
+		pong_resources_internal_finishRequest(request);
+	return is_ready;
+}
+
+void pong_resources_waitForRequest(struct PongResourceRequest *request) {
+	pthread_mutex_lock(&resource_requests_mutex);
+	while (request->state == PONG_RESOURCES_REQUEST_QUEUED)
+		pthread_cond_wait(&resource_requests_done_cond, &resource_requests_mutex);
+	pthread_mutex_unlock(&resource_requests_mutex);
+	pong_resources_internal_finishRequest(request);
+}
+
+// Forgets the resource entirely, it has to be loaded again before it can be used
 void pong_resources_unload(const char *resource_id) {
 	PONG_LOG_SUBGROUP_START("ResourceUnload");
 	PONG_LOG("Deallocating resource '%s'...", PONG_LOG_VERBOSE, resource_id);
-	pong_resources_internal_deleteResourceMap(pong_resources_internal_getResourceMap(resource_id));
+	struct PongCachedResource **mapped_resource = pong_hashmap_get(&resource_map, resource_id);
+	if (!mapped_resource)
+		PONG_ERROR("Attempted to unload resource with ID '%s' but it isn't loaded!", resource_id);
+	struct PongCachedResource *cached_resource = *mapped_resource;
+	if (cached_resource->reference_count)
+		PONG_ERROR("Attempted to unload resource with ID '%s' while it still has %u references!", resource_id, cached_resource->reference_count);
+	if (cached_resource->is_resident)
+		pong_resources_internal_evictResource(cached_resource);
+#ifdef PONG_RESOURCES_PROFILING
+	cached_resource->stats->unload_count++;
+#endif
+	pong_hashmap_remove(&resource_map, resource_id, NULL);
+	free(cached_resource);
 	PONG_LOG_SUBGROUP_END();
 }
 
-void *pong_resources_get(const char *resource_id) {
+// Resources used in place aren't null-terminated, so use pong_resources_getSize() rather than assuming text
+// The data is only guaranteed to stay put until the next call that can evict, use pong_resources_acquire() to hold onto it
+const void *pong_resources_get(const char *resource_id) {
 	PONG_LOG_SUBGROUP_START("ResourceGet");
-	struct PongResourceMap *resource_map = pong_resources_internal_getResourceMap(resource_id)->data;
+	struct PongCachedResource *cached_resource = pong_resources_internal_getResource(resource_id);
+	pong_resources_internal_makeResident(cached_resource);
+	pong_resources_internal_touchResource(cached_resource);
+	PONG_LOG_SUBGROUP_END();
+	return cached_resource->resource.data;
+}
+
+// Only up to date once the resource has been got or acquired, as hot reloaded files can change size
+size_t pong_resources_getSize(const char *resource_id) {
+	return pong_resources_internal_getResource(resource_id)->resource.size;
+}
+
+// For resources loaded with their path from resource_ids.h as their ID, looked up by the matching _HASH
+// No strings are hashed or compared, so these are cheap enough to call every frame
+const void *pong_resources_getHashed(unsigned int resource_hash) {
+	struct PongCachedResource *cached_resource = pong_resources_internal_getHashedResource(resource_hash);
+	pong_resources_internal_makeResident(cached_resource);
+	pong_resources_internal_touchResource(cached_resource);
+	return cached_resource->resource.data;
+}
+
+size_t pong_resources_getSizeHashed(unsigned int resource_hash) {
+	return pong_resources_internal_getHashedResource(resource_hash)->resource.size;
+}
+
+// Referenced resources are never evicted, their data stays valid until the matching pong_resources_release()
+// Evicted resources are read back in from the archive
+const void *pong_resources_acquire(const char *resource_id) {
+	PONG_LOG_SUBGROUP_START("ResourceAcquire");
+	const void *resource_data = pong_resources_internal_acquireResource(pong_resources_internal_getResource(resource_id));
+	PONG_LOG_SUBGROUP_END();
+	return resource_data;
+}
+
+const void *pong_resources_acquireHashed(unsigned int resource_hash) {
+	return pong_resources_internal_acquireResource(pong_resources_internal_getHashedResource(resource_hash));
+}
+
+// Once a resource has no references left it stays cached, but may be evicted to keep within the budget
+void pong_resources_release(const char *resource_id) {
+	PONG_LOG_SUBGROUP_START("ResourceRelease");
+	pong_resources_internal_releaseResource(pong_resources_internal_getResource(resource_id));
 	PONG_LOG_SUBGROUP_END();
-	return resource_map;
+}
+
+void pong_resources_releaseHashed(unsigned int resource_hash) {
+	pong_resources_internal_releaseResource(pong_resources_internal_getHashedResource(resource_hash));
+}
+
+// Only decompressed copies count towards the budget, resources used in place live in the archive's mapping
+void pong_resources_setBudget(size_t budget) {
+	PONG_LOG("Setting resource budget to %zu bytes...", PONG_LOG_VERBOSE, budget);
+	resource_budget = budget;
+	pong_resources_internal_evictToFit(0);
+}
+
+size_t pong_resources_getResidentSize(void) {
+	return resident_size;
+}
+
+#ifdef PONG_HOT_RELOAD
+// Callbacks are run on the main thread with the ID of each changed resource, after its old data has been evicted
+void pong_resources_addReloadCallback(PongResourceReloadCallback callback) {
+	PongResourceReloadCallback *new_reload_callbacks = realloc(reload_callbacks, sizeof (PongResourceReloadCallback) * (reload_callback_count + 1));
+	if (!new_reload_callbacks)
+		PONG_ERROR("Could not reallocate memory for resource reload callbacks!");
+	reload_callbacks = new_reload_callbacks;
+	reload_callbacks[reload_callback_count++] = callback;
+}
+
+void pong_resources_removeReloadCallback(PongResourceReloadCallback callback) {
+	unsigned int shift = 0;
+	for (unsigned int i = 0; i < reload_callback_count; i++)
+		if (reload_callbacks[i] != callback)
+			reload_callbacks[shift++] = reload_callbacks[i];
+	reload_callback_count = shift;
+}
+
+// Evicts every resource whose file has changed so it's read fresh next time it's used, then lets callbacks rebuild from it
+// Must be called on the main thread, the game loop does so between frames
+void pong_resources_reloadChanged(void) {
+	const char *changed_file_path;
+	while ((changed_file_path = pong_watcher_poll())) {
+		PONG_LOG_SUBGROUP_START("HotReload");
+		PONG_LOG("'%s' changed on disk...", PONG_LOG_VERBOSE, changed_file_path);
+		unsigned int changed_resource_count = 0;
+		struct PongCachedResource **cached_resource;
+		for (unsigned int iterator = 0; pong_hashmap_iterate(&resource_map, &iterator, NULL, (void **) &cached_resource);) {
+			if (strcmp((*cached_resource)->file_path, changed_file_path))
+				continue;
+			if ((*cached_resource)->reference_count) {
+				PONG_LOG("Resource '%s' is still referenced, it can't be reloaded!", PONG_LOG_WARNING, (*cached_resource)->resource_id);
+				continue;
+			}
+			if ((*cached_resource)->is_resident)
+				pong_resources_internal_evictResource(*cached_resource);
+			(*cached_resource)->resource.size = 0; // the file may have changed size too, it's known again once read back in
+			if (changed_resource_count == changed_resource_capacity) {
+				unsigned int new_changed_resource_capacity = changed_resource_capacity ? changed_resource_capacity * 2 : PONG_RESOURCES_RELOAD_IDS_INITIAL_CAPACITY;
+				const char **new_changed_resource_ids = realloc(changed_resource_ids, sizeof (const char *) * new_changed_resource_capacity);
+				if (!new_changed_resource_ids)
+					PONG_ERROR("Could not reallocate memory for changed resource IDs!");
+				changed_resource_ids = new_changed_resource_ids;
+				changed_resource_capacity = new_changed_resource_capacity;
+			}
+			changed_resource_ids[changed_resource_count++] = (*cached_resource)->resource_id;
+		}
+
+		// Callbacks may load or unload resources, so they're only run once the map has been walked
+		for (unsigned int i = 0; i < changed_resource_count; i++) {
+			PONG_LOG("Reloading resource '%s'...", PONG_LOG_INFO, changed_resource_ids[i]);
+			for (unsigned int j = 0; j < reload_callback_count; j++)
+				reload_callbacks[j](changed_resource_ids[i]);
+		}
+		PONG_LOG_SUBGROUP_END();
+	}
+}
+#endif
+
+// Logs what every resource loaded so far has cost, slowest to load first, along with how crowded the resource map is
+// Must be called on the main thread, it's also reported on cleanup
+void pong_resources_report(void) {
+#ifdef PONG_RESOURCES_PROFILING
+	PONG_LOG_SUBGROUP_START("ResourceReport");
+	struct PongResourceStats **sorted_stats = malloc(sizeof (struct PongResourceStats *) * (resource_stats_map.count ? resource_stats_map.count : 1));
+	if (!sorted_stats) {
+		PONG_LOG("Could not allocate memory for resource report!", PONG_LOG_WARNING);
+		PONG_LOG_SUBGROUP_END();
+		return;
+	}
+	unsigned int stats_count = 0;
+	struct PongResourceStats **stats;
+	for (unsigned int iterator = 0; pong_hashmap_iterate(&resource_stats_map, &iterator, NULL, (void **) &stats);)
+		sorted_stats[stats_count++] = *stats;
+	qsort(sorted_stats, stats_count, sizeof (struct PongResourceStats *), pong_resources_internal_compareStats);
+
+	unsigned long long total_find_nsec = 0, total_read_nsec = 0;
+	size_t total_stored_size = 0, total_size = 0;
+	PONG_LOG("Resource loads (loads/evicts/unloads, find, read, stored -> size, lookups, mean/max probe):", PONG_LOG_INFO);
+	for (unsigned int i = 0; i < stats_count; i++) {
+		const struct PongResourceStats *resource_stats = sorted_stats[i];
+		PONG_LOG("%-24s %3u/%3u/%3u %9.1fus %9.1fus %9zu -> %9zu bytes %9lu lookups %5.2f/%2u  '%s'", PONG_LOG_INFO,
+			resource_stats->resource_id, resource_stats->load_count, resource_stats->evict_count, resource_stats->unload_count,
+			resource_stats->find_nsec / 1e3, resource_stats->read_nsec / 1e3, resource_stats->stored_size, resource_stats->size, resource_stats->lookup_count,
+			resource_stats->lookup_count ? (double) resource_stats->total_probe_length / resource_stats->lookup_count : 0.0, resource_stats->max_probe_length, resource_stats->file_path);
+		total_find_nsec += resource_stats->find_nsec;
+		total_read_nsec += resource_stats->read_nsec;
+		total_stored_size += resource_stats->stored_size;
+		total_size += resource_stats->size;
+	}
+	PONG_LOG("%u resources took %.1fus to find and %.1fus to read, %zu -> %zu bytes.", PONG_LOG_INFO,
+		stats_count, total_find_nsec / 1e3, total_read_nsec / 1e3, total_stored_size, total_size);
+
+	struct PongHashMapStats map_stats;
+	pong_hashmap_getStats(&resource_map, &map_stats);
+	PONG_LOG("Resource map holds %u of %u slots (%.0f%% full), mean probe %.2f, max probe %u.", PONG_LOG_INFO,
+		map_stats.count, map_stats.capacity, 100.0 * map_stats.count / map_stats.capacity,
+		map_stats.count ? (double) map_stats.total_probe_length / map_stats.count : 0.0, map_stats.max_probe_length);
+	PONG_LOG("Resident resource memory is %zu bytes (peak %zu) of a %zu byte budget.", PONG_LOG_INFO, resident_size, peak_resident_size, resource_budget);
+	free(sorted_stats);
+	PONG_LOG_SUBGROUP_END();
+#endif
 }
 
 void pong_resources_cleanup(void) {
 	PONG_LOG_SUBGROUP_START("Resources");
 	PONG_LOG("Cleaning up resource manager...", PONG_LOG_INFO);
-	PONG_LOG("Clearing resource map table...", PONG_LOG_VERBOSE);
-	struct PongResourceMap *resource_map = resource_map_table;
-	while (resource_map_table_bucket_count--)
-		free(resource_map++->data);
-	free(resource_map_table);
+	PONG_LOG("Stopping resource loading workers...", PONG_LOG_VERBOSE);
+	pthread_mutex_lock(&resource_requests_mutex);
+	are_resource_workers_stopping = 1;
+	pthread_cond_broadcast(&resource_requests_queued_cond);
+	pthread_mutex_unlock(&resource_requests_mutex);
+	for (unsigned int i = 0; i < PONG_RESOURCES_WORKER_COUNT; i++) {
+		if (resource_workers[i].is_running)
+			pthread_join(resource_workers[i].thread, NULL);
+		resource_workers[i] = (struct PongResourceWorker) { 0 };
+	}
+	PONG_LOG("Discarding unfinished resource requests...", PONG_LOG_VERBOSE);
+	while (resource_requests_outstanding) {
+		struct PongResourceRequest *request = resource_requests_outstanding;
+		resource_requests_outstanding = request->next_outstanding;
+		if (request->state == PONG_RESOURCES_REQUEST_LOADED && !request->loaded_resource.is_mapped)
+			free((void *) request->loaded_resource.data);
+		free(request);
+	}
+	resource_requests_queue_head = resource_requests_queue_tail = NULL;
+	pong_resources_report();
+	PONG_LOG("Clearing resource map...", PONG_LOG_VERBOSE);
+	PONG_LOG("Peak resident resource memory was %zu bytes of a %zu byte budget.", PONG_LOG_VERBOSE, peak_resident_size, resource_budget);
+	struct PongCachedResource **cached_resource;
+	for (unsigned int iterator = 0; pong_hashmap_iterate(&resource_map, &iterator, NULL, (void **) &cached_resource);) {
+		if ((*cached_resource)->is_resident && !(*cached_resource)->resource.is_mapped)
+			free((void *) (*cached_resource)->resource.data);
+		free(*cached_resource);
+	}
+	pong_hashmap_cleanup(&resource_map);
+#ifdef PONG_RESOURCES_PROFILING
+	struct PongResourceStats **stats;
+	for (unsigned int iterator = 0; pong_hashmap_iterate(&resource_stats_map, &iterator, NULL, (void **) &stats);) {
+		free((*stats)->resource_id);
+		free((*stats)->file_path);
+		free(*stats);
+	}
+	pong_hashmap_cleanup(&resource_stats_map);
+#endif
+	resource_lru_head = resource_lru_tail = NULL;
+	resident_size = peak_resident_size = 0;
+#ifdef PONG_HOT_RELOAD
+	free(reload_callbacks);
+	reload_callbacks = NULL;
+	reload_callback_count = 0;
+	free(changed_resource_ids);
+	changed_resource_ids = NULL;
+	changed_resource_capacity = 0;
+	pong_watcher_cleanup();
+#endif
 	PONG_LOG("Closing data archive...", PONG_LOG_VERBOSE);
-	if (zip_archive)
-		zip_close(zip_archive);
+	free(archive_entries);
+	archive_entries = NULL;
+	archive_entry_count = 0;
+	if (archive_data)
+		pong_files_unmapFile(archive_data, archive_size);
+	archive_data = NULL;
 	PONG_LOG_SUBGROUP_END();
 }
 
-// Using djb2 hashing algorithm because I'm that basic
-static unsigned int pong_resources_internal_getHashIndex(const char *key) {
-	PONG_LOG_SUBGROUP_START("HashFunc");
-	if (!resource_map_table_bucket_count)
-		PONG_ERROR("Attempted to find hash index for the key '%s' but the resource map table doesn't even have any buckets!", key);
-	const char *key_char = key;
-	unsigned int hash_index = 5381;
-	while (*key_char++)
-		hash_index = ((hash_index << 5) + hash_index) + *key_char;
-	PONG_LOG_SUBGROUP_END();
-	return hash_index % resource_map_table_bucket_count;
+static struct PongCachedResource *pong_resources_internal_getResource(const char *resource_id) {
+	struct PongCachedResource **cached_resource = pong_hashmap_get(&resource_map, resource_id);
+	if (!cached_resource)
+		PONG_ERROR("Could not locate resource with ID '%s'!", resource_id);
+#ifdef PONG_RESOURCES_PROFILING
+	pong_resources_internal_recordLookup(cached_resource);
+#endif
+	return *cached_resource;
 }
 
-static struct PongResourceMap *pong_resources_internal_getResourceMap(const char *key) {
-	unsigned int attempt = 0, hash_index = pong_resources_internal_getHashIndex(key);
-	while (resource_map_table[hash_index].key && strcmp(resource_map_table[hash_index].key, key)) {
-		if (++attempt >= resource_map_table_bucket_count)
-			PONG_ERROR("Could not locate resource with ID '%s'!", key);
-		hash_index = (hash_index + 1) % resource_map_table_bucket_count;
+static struct PongCachedResource *pong_resources_internal_getHashedResource(unsigned int resource_hash) {
+	struct PongCachedResource **cached_resource = pong_hashmap_getHashed(&resource_map, resource_hash);
+	if (!cached_resource)
+		PONG_ERROR("Could not locate resource with hash 0x%08x!", resource_hash);
+#ifdef PONG_RESOURCES_PROFILING
+	pong_resources_internal_recordLookup(cached_resource);
+#endif
+	return *cached_resource;
+}
+
+static const void *pong_resources_internal_acquireResource(struct PongCachedResource *cached_resource) {
+	pong_resources_internal_makeResident(cached_resource);
+	if (!cached_resource->reference_count++ && !cached_resource->resource.is_mapped)
+		pong_resources_internal_unlinkLRU(cached_resource);
+	return cached_resource->resource.data;
+}
+
+static void pong_resources_internal_releaseResource(struct PongCachedResource *cached_resource) {
+	if (!cached_resource->reference_count)
+		PONG_ERROR("Attempted to release resource '%s' but it isn't referenced!", cached_resource->resource_id);
+	if (!--cached_resource->reference_count && !cached_resource->resource.is_mapped) {
+		pong_resources_internal_linkLRU(cached_resource);
+		pong_resources_internal_evictToFit(0);
 	}
-	if (!resource_map_table[hash_index].data)
-		PONG_ERROR("Attempted to get resource with ID '%s' but it's already been unloaded!");
-	return resource_map_table + hash_index;
 }
 
-static struct PongResourceMap *pong_resources_internal_getEmptyResourceMap(const char *key) {
-	unsigned int attempt = 0, hash_index = pong_resources_internal_getHashIndex(key);
-	while (resource_map_table[hash_index].data) {
-		if (!strcmp(resource_map_table[hash_index].key, key))
-			PONG_ERROR("Attempted to overwrite resource ID '%s'!", key);
-		if (++attempt >= resource_map_table_bucket_count)
-			PONG_ERROR("Could not find available empty resource map for resource with ID '%s'!", key);
-		hash_index = (hash_index + 1) % resource_map_table_bucket_count;
+// Reads an evicted resource back in from the archive, errors the same way a failed load would
+static void pong_resources_internal_makeResident(struct PongCachedResource *cached_resource) {
+	if (cached_resource->is_resident)
+		return;
+	PONG_LOG("Reloading evicted resource '%s'...", PONG_LOG_VERBOSE, cached_resource->resource_id);
+	struct PongResource loaded_resource;
+	const char *error_message = pong_resources_internal_readResource(cached_resource->file_path, &loaded_resource);
+	if (error_message)
+		PONG_ERROR("An error occurred while trying to reload resource '%s': %s", cached_resource->file_path, error_message);
+	pong_resources_internal_admitResource(cached_resource, loaded_resource);
+	if (!cached_resource->reference_count && !loaded_resource.is_mapped)
+		pong_resources_internal_linkLRU(cached_resource);
+}
+
+// Makes room for a freshly loaded copy before counting it, the caller links it into the LRU list if it's unreferenced
+static void pong_resources_internal_admitResource(struct PongCachedResource *cached_resource, struct PongResource loaded_resource) {
+	if (!loaded_resource.is_mapped) {
+		pong_resources_internal_evictToFit(loaded_resource.size);
+		resident_size += loaded_resource.size;
+		if (resident_size > peak_resident_size)
+			peak_resident_size = resident_size;
+		if (resident_size > resource_budget)
+			PONG_LOG("Resource budget exceeded by %zu bytes, all other resources are referenced!", PONG_LOG_WARNING, resident_size - resource_budget);
 	}
-	return resource_map_table + hash_index;
+	cached_resource->resource = loaded_resource;
+	cached_resource->is_resident = 1;
+#ifdef PONG_RESOURCES_PROFILING
+	pong_resources_internal_recordLoad(cached_resource->stats, loaded_resource);
+#endif
 }
 
-static void pong_resources_internal_deleteResourceMap(struct PongResourceMap *resource_map) {
-	free(resource_map->data);
-	resource_map->data = NULL;
-	resource_map_table_used_bucket_count--;
+static void pong_resources_internal_touchResource(struct PongCachedResource *cached_resource) {
+	if (!cached_resource->reference_count && !cached_resource->resource.is_mapped && cached_resource != resource_lru_head) {
+		pong_resources_internal_unlinkLRU(cached_resource);
+		pong_resources_internal_linkLRU(cached_resource);
+	}
 }
 
-static void pong_resources_internal_setBucketCount(unsigned int new_bucket_count) {
-	PONG_LOG_SUBGROUP_START("SetBucketCount");
-	PONG_LOG("Changing max number of resources from %i to %i...", PONG_LOG_INFO, resource_map_table_bucket_count, new_bucket_count);
+// Frees the resource's data but keeps it registered, its size is left as-is since the archive won't change
+// Loose files can, so pong_resources_reloadChanged() clears the size of any that do
+static void pong_resources_internal_evictResource(struct PongCachedResource *cached_resource) {
+	if (!cached_resource->resource.is_mapped) {
+		PONG_LOG("Evicting resource '%s' to free %zu bytes...", PONG_LOG_VERBOSE, cached_resource->resource_id, cached_resource->resource.size);
+		if (!cached_resource->reference_count)
+			pong_resources_internal_unlinkLRU(cached_resource);
+		free((void *) cached_resource->resource.data);
+		resident_size -= cached_resource->resource.size;
+	}
+	cached_resource->resource.data = NULL;
+	cached_resource->is_resident = 0;
+}
 
-	struct PongResourceMap *old_resource_map_table = resource_map_table;
-	unsigned int old_resource_map_table_bucket_count = resource_map_table_bucket_count;
-	resource_map_table_bucket_count = new_bucket_count;
-	resource_map_table = calloc(1, sizeof (struct PongResourceMap) * resource_map_table_bucket_count);
-	if (!resource_map_table) {
-		resource_map_table = old_resource_map_table;
-		resource_map_table_bucket_count = old_resource_map_table_bucket_count;
-		PONG_ERROR("Could not allocate memory for resource map!");
+// Evicts least recently used resources until incoming_size more bytes would fit in the budget, or there's nothing left to evict
+static void pong_resources_internal_evictToFit(size_t incoming_size) {
+	while (resource_lru_tail && (incoming_size > resource_budget || resident_size > resource_budget - incoming_size)) {
+#ifdef PONG_RESOURCES_PROFILING
+		resource_lru_tail->stats->evict_count++;
+#endif
+		pong_resources_internal_evictResource(resource_lru_tail);
 	}
+}
 
-	PONG_LOG("Rehashing resource map entries...", PONG_LOG_VERBOSE);
-	for (struct PongResourceMap *old_resource_map = old_resource_map_table; old_resource_map_table_bucket_count--; old_resource_map++) {
-		if (old_resource_map->data) {
-			struct PongResourceMap *new_resource_map = pong_resources_internal_getEmptyResourceMap(old_resource_map->key);
-			*new_resource_map = *old_resource_map;
-		}
+static void pong_resources_internal_linkLRU(struct PongCachedResource *cached_resource) {
+	cached_resource->lru_prev = NULL;
+	cached_resource->lru_next = resource_lru_head;
+	if (resource_lru_head)
+		resource_lru_head->lru_prev = cached_resource;
+	else
+		resource_lru_tail = cached_resource;
+	resource_lru_head = cached_resource;
+}
+
+static void pong_resources_internal_unlinkLRU(struct PongCachedResource *cached_resource) {
+	if (cached_resource->lru_prev)
+		cached_resource->lru_prev->lru_next = cached_resource->lru_next;
+	else
+		resource_lru_head = cached_resource->lru_next;
+	if (cached_resource->lru_next)
+		cached_resource->lru_next->lru_prev = cached_resource->lru_prev;
+	else
+		resource_lru_tail = cached_resource->lru_prev;
+	cached_resource->lru_prev = cached_resource->lru_next = NULL;
+}
+
+// Reads a resource out of the archive without touching the resource map, so it's safe to call from workers
+// Returns NULL on success, otherwise a message describing what went wrong
+static const char *pong_resources_internal_readResource(const char *file_path, struct PongResource *loaded_resource) {
+#ifdef PONG_RESOURCES_PROFILING
+	unsigned long long start_nsec = pong_timing_getNsec();
+#endif
+	const struct PongResourceEntry *entry = NULL;
+#ifdef PONG_HOT_RELOAD
+	// Loose files are preferred so they can be edited while running, anything not in res/ still comes from the archive
+	FILE *loose_file = pong_resources_internal_openLooseFile(file_path);
+	if (!loose_file)
+#endif
+	{
+		PONG_LOG("Querying resource...", PONG_LOG_VERBOSE);
+		entry = pong_resources_internal_findEntry(file_path);
+		if (!entry)
+			return "No such resource in the archive!";
+	}
+#ifdef PONG_RESOURCES_PROFILING
+	unsigned long long found_nsec = pong_timing_getNsec();
+#endif
+
+	const char *error_message;
+#ifdef PONG_HOT_RELOAD
+	if (loose_file)
+		error_message = pong_resources_internal_readLooseFile(loose_file, loaded_resource);
+	else
+#endif
+	error_message = pong_resources_internal_readEntry(entry, loaded_resource);
+#ifdef PONG_RESOURCES_PROFILING
+	if (!error_message) {
+		loaded_resource->find_nsec = found_nsec - start_nsec;
+		loaded_resource->read_nsec = pong_timing_getNsec() - found_nsec;
+		loaded_resource->stored_size = entry ? entry->stored_size : loaded_resource->size;
+	}
+#endif
+	return error_message;
+}
+
+static const char *pong_resources_internal_readEntry(const struct PongResourceEntry *entry, struct PongResource *loaded_resource) {
+	if (entry->method == PONG_PACK_STORED) {
+		PONG_LOG("Resource is stored uncompressed, using it in place...", PONG_LOG_VERBOSE);
+		*loaded_resource = (struct PongResource) { entry->payload, entry->size, 1 };
+		return NULL;
+	}
+
+	PONG_LOG("Decompressing resource...", PONG_LOG_VERBOSE);
+	unsigned char *data = malloc(sizeof (unsigned char) * entry->size + 1);
+	if (!data)
+		return "Could not allocate memory for resource!";
+	const char *error_message = pong_resources_internal_decompressEntry(entry, data);
+	if (error_message) {
+		free(data);
+		return error_message;
+	}
+	data[entry->size] = '\0';
+	*loaded_resource = (struct PongResource) { data, entry->size, 0 };
+	return NULL;
+}
+
+// Decompresses each of an LZ4 entry's blocks into data, which must have room for the entry's full size
+static const char *pong_resources_internal_decompressEntry(const struct PongResourceEntry *entry, unsigned char *data) {
+	const unsigned char *cursor = entry->payload;
+	for (size_t offset = 0; offset < entry->size; offset += PONG_PACK_BLOCK_SIZE) {
+		struct PongResourceBlock block;
+		const char *error_message = pong_resources_internal_readBlockHeader(entry, &cursor, offset, data + offset, &block);
+		if (!error_message)
+			error_message = pong_resources_internal_decompressBlock(&block);
+		if (error_message)
+			return error_message;
+	}
+	return NULL;
+}
+
+// Works out where the block starting at offset comes from, moving the cursor on to the next block's header
+static const char *pong_resources_internal_readBlockHeader(const struct PongResourceEntry *entry, const unsigned char **cursor, size_t offset, unsigned char *destination, struct PongResourceBlock *block) {
+	const unsigned char *payload_end = entry->payload + entry->stored_size;
+	if (payload_end - *cursor < PONG_PACK_BLOCK_HEADER_SIZE)
+		return "Resource data is truncated!";
+	unsigned int block_header = pong_resources_internal_readU32(*cursor);
+	*block = (struct PongResourceBlock) {
+		.source = *cursor + PONG_PACK_BLOCK_HEADER_SIZE,
+		.source_size = block_header & ~PONG_PACK_BLOCK_UNCOMPRESSED,
+		.destination = destination,
+		.size = entry->size - offset < PONG_PACK_BLOCK_SIZE ? entry->size - offset : PONG_PACK_BLOCK_SIZE,
+		.is_compressed = !(block_header & PONG_PACK_BLOCK_UNCOMPRESSED)
+	};
+	if (block->source_size > (size_t) (payload_end - block->source))
+		return "Resource data is truncated!";
+	if (!block->is_compressed && block->source_size != block->size)
+		return "Resource data is corrupt!";
+	*cursor = block->source + block->source_size;
+	return NULL;
+}
+
+static const char *pong_resources_internal_decompressBlock(const struct PongResourceBlock *block) {
+	if (!block->is_compressed)
+		memcpy(block->destination, block->source, block->size);
+	else if (pong_lz4_decompress(block->source, block->source_size, block->destination, block->size) != (int) block->size)
+		return "Resource data is corrupt!";
+	return NULL;
+}
+
+// Closes the stream before raising the error, file_path is passed separately as the stream is gone by then
+static _Noreturn void pong_resources_internal_failStream(struct PongResourceStream *stream, const char *file_path, const char *error_message) {
+	pong_resources_closeStream(stream);
+	PONG_ERROR("An error occurred while trying to stream resource '%s': %s", file_path, error_message);
+}
+
+// Each block is only ever written by the thread that claimed it, so its error needs no locking
+static void pong_resources_internal_decompressBatchBlocks(struct PongResourceBatch *batch) {
+	unsigned int block_index;
+	while ((block_index = atomic_fetch_add(&batch->next_block, 1)) < batch->block_count) {
+#ifdef PONG_RESOURCES_PROFILING
+		unsigned long long start_nsec = pong_timing_getNsec();
+#endif
+		batch->blocks[block_index].error_message = pong_resources_internal_decompressBlock(batch->blocks + block_index);
+#ifdef PONG_RESOURCES_PROFILING
+		batch->blocks[block_index].nsec = pong_timing_getNsec() - start_nsec;
+#endif
 	}
+}
+
+static unsigned int pong_resources_internal_hasUnclaimedBlocks(struct PongResourceBatch *batch) {
+	return batch && atomic_load(&batch->next_block) < batch->block_count;
+}
+
+#ifdef PONG_HOT_RELOAD
+static FILE *pong_resources_internal_openLooseFile(const char *file_path) {
+	char full_path[PONG_RESOURCES_LOOSE_PATH_BUF_SIZE];
+	if (snprintf(full_path, PONG_RESOURCES_LOOSE_PATH_BUF_SIZE, "%s%s", PONG_HOT_RELOAD_ROOT, file_path) >= PONG_RESOURCES_LOOSE_PATH_BUF_SIZE)
+		return NULL;
+	return fopen(full_path, "rb");
+}
 
-	free(old_resource_map_table);
-	PONG_LOG("Successfully changed size of resource map table!", PONG_LOG_VERBOSE);
+// Takes ownership of the file and closes it
+static const char *pong_resources_internal_readLooseFile(FILE *file, struct PongResource *loaded_resource) {
+	PONG_LOG("Reading loose resource file...", PONG_LOG_VERBOSE);
+	long file_size = -1;
+	if (!fseek(file, 0, SEEK_END))
+		file_size = ftell(file);
+	if (file_size < 0 || fseek(file, 0, SEEK_SET)) {
+		fclose(file);
+		return "Could not get size of loose resource file!";
+	}
+	char *data = malloc(sizeof (char) * file_size + 1);
+	if (!data) {
+		fclose(file);
+		return "Could not allocate memory for resource!";
+	}
+	if (fread(data, 1, file_size, file) != (size_t) file_size) {
+		fclose(file);
+		free(data);
+		return "Could not read loose resource file!";
+	}
+	fclose(file);
+	data[file_size] = '\0';
+	*loaded_resource = (struct PongResource) { data, file_size, 0 };
+	return NULL;
+}
+#endif
+
+// Newly loaded resources start unreferenced, so they're the first in line for eviction after anything used since
+static void pong_resources_internal_mapResource(const char *file_path, const char *resource_id, struct PongResource loaded_resource) {
+	PONG_LOG("Mapping resource...", PONG_LOG_VERBOSE);
+	struct PongCachedResource *cached_resource = calloc(1, sizeof (struct PongCachedResource));
+	if (!cached_resource) {
+		if (!loaded_resource.is_mapped)
+			free((void *) loaded_resource.data);
+		PONG_ERROR("Could not allocate memory for resource '%s'!", resource_id);
+	}
+	// Resources can be looked up by hash alone, so IDs must have unique hashes as well as being unique themselves
+	struct PongCachedResource **mapped_resource = NULL;
+	if (!pong_hashmap_getHashed(&resource_map, pong_hash_string(resource_id)))
+		mapped_resource = pong_hashmap_insert(&resource_map, resource_id);
+	if (!mapped_resource) {
+		if (!loaded_resource.is_mapped)
+			free((void *) loaded_resource.data);
+		free(cached_resource);
+		PONG_ERROR("Attempted to overwrite resource ID '%s' (or another ID with the same hash)!", resource_id);
+	}
+	*mapped_resource = cached_resource;
+	cached_resource->file_path = file_path;
+	cached_resource->resource_id = resource_id;
+#ifdef PONG_RESOURCES_PROFILING
+	cached_resource->stats = pong_resources_internal_getStats(file_path, resource_id);
+#endif
+	pong_resources_internal_admitResource(cached_resource, loaded_resource);
+	if (!loaded_resource.is_mapped)
+		pong_resources_internal_linkLRU(cached_resource);
+}
+
+// Maps a request's loaded resource (or raises its error) and frees the request
+static void pong_resources_internal_finishRequest(struct PongResourceRequest *request) {
+	PONG_LOG_SUBGROUP_START("ResourceLoad");
+	pthread_mutex_lock(&resource_requests_mutex);
+	struct PongResourceRequest **outstanding = &resource_requests_outstanding;
+	while (*outstanding != request)
+		outstanding = &(*outstanding)->next_outstanding;
+	*outstanding = request->next_outstanding;
+	pthread_mutex_unlock(&resource_requests_mutex);
+
+	struct PongResourceRequest finished_request = *request;
+	free(request);
+	if (finished_request.state == PONG_RESOURCES_REQUEST_FAILED)
+		PONG_ERROR("An error occurred while trying to load requested resource '%s': %s", finished_request.file_path, finished_request.error_message);
+	pong_resources_internal_mapResource(finished_request.file_path, finished_request.resource_id, finished_request.loaded_resource);
+	PONG_LOG("Resource '%s' successfully loaded in the background and mapped to '%s'...", PONG_LOG_VERBOSE, finished_request.file_path, finished_request.resource_id);
 	PONG_LOG_SUBGROUP_END();
 }
 
+static void *pong_resources_internal_workerThread(void *arg) {
+	pthread_mutex_lock(&resource_requests_mutex);
+	while (1) {
+		while (!resource_requests_queue_head && !pong_resources_internal_hasUnclaimedBlocks(active_resource_batch) && !are_resource_workers_stopping)
+			pthread_cond_wait(&resource_requests_queued_cond, &resource_requests_mutex);
+		if (are_resource_workers_stopping)
+			break;
+
+		// Batches come first, as whoever started one is blocked until it's done
+		if (pong_resources_internal_hasUnclaimedBlocks(active_resource_batch)) {
+			struct PongResourceBatch *batch = active_resource_batch;
+			batch->active_worker_count++;
+			pthread_mutex_unlock(&resource_requests_mutex);
+			PONG_LOG_SUBGROUP_START("ResourceBatchWorker");
+			pong_resources_internal_decompressBatchBlocks(batch);
+			PONG_LOG_SUBGROUP_END();
+			pthread_mutex_lock(&resource_requests_mutex);
+			if (!--batch->active_worker_count)
+				pthread_cond_broadcast(&resource_requests_done_cond);
+			continue;
+		}
+
+		struct PongResourceRequest *request = resource_requests_queue_head;
+		resource_requests_queue_head = request->next_queued;
+		if (!resource_requests_queue_head)
+			resource_requests_queue_tail = NULL;
+		pthread_mutex_unlock(&resource_requests_mutex);
+
+		PONG_LOG_SUBGROUP_START("ResourceWorker");
+		PONG_LOG("Loading resource at '%s' in the background...", PONG_LOG_VERBOSE, request->file_path);
+		struct PongResource loaded_resource = { 0 };
+		const char *error_message = pong_resources_internal_readResource(request->file_path, &loaded_resource);
+		if (error_message)
+			snprintf(request->error_message, PONG_RESOURCES_REQUEST_ERROR_MSG_BUF_SIZE, "%s", error_message);
+		PONG_LOG_SUBGROUP_END();
+
+		pthread_mutex_lock(&resource_requests_mutex);
+		request->loaded_resource = loaded_resource;
+		request->state = error_message ? PONG_RESOURCES_REQUEST_FAILED : PONG_RESOURCES_REQUEST_LOADED;
+		pthread_cond_broadcast(&resource_requests_done_cond);
+	}
+	pthread_mutex_unlock(&resource_requests_mutex);
+	return NULL;
+}
+
+// Checks the pack's header and index up front, so nothing after this has to trust offsets read from the file
+static void pong_resources_internal_indexArchive(void) {
+	PONG_LOG("Indexing resource data archive...", PONG_LOG_VERBOSE);
+	if (archive_size < PONG_PACK_HEADER_SIZE || pong_resources_internal_readU32(archive_data) != PONG_PACK_MAGIC)
+		PONG_ERROR("Resource data archive is not a resource pack!");
+	if (pong_resources_internal_readU32(archive_data + 4) != PONG_PACK_VERSION)
+		PONG_ERROR("Resource data archive is version %u, but version %u is required!", pong_resources_internal_readU32(archive_data + 4), PONG_PACK_VERSION);
+	unsigned int entry_count = pong_resources_internal_readU32(archive_data + 8);
+	size_t names_size = pong_resources_internal_readU32(archive_data + 12);
+	size_t names_offset = PONG_PACK_HEADER_SIZE + (size_t) PONG_PACK_ENTRY_SIZE * entry_count;
+	if (names_offset > archive_size || names_size > archive_size - names_offset || (names_size && archive_data[names_offset + names_size - 1]))
+		PONG_ERROR("Resource data archive index is corrupt!");
+
+	archive_entries = malloc(sizeof (struct PongResourceEntry) * (entry_count ? entry_count : 1));
+	if (!archive_entries)
+		PONG_ERROR("Could not allocate memory for resource data archive index!");
+	unsigned int previous_hash = 0;
+	for (unsigned int i = 0; i < entry_count; i++) {
+		const unsigned char *index_entry = archive_data + PONG_PACK_HEADER_SIZE + (size_t) PONG_PACK_ENTRY_SIZE * i;
+		size_t name_offset = pong_resources_internal_readU32(index_entry + 4);
+		unsigned long long payload_offset = pong_resources_internal_readU64(index_entry + 16);
+		struct PongResourceEntry *entry = archive_entries + i;
+		*entry = (struct PongResourceEntry) {
+			.hash = pong_resources_internal_readU32(index_entry),
+			.method = pong_resources_internal_readU32(index_entry + 8),
+			.path = (const char *) archive_data + names_offset + name_offset,
+			.size = pong_resources_internal_readU32(index_entry + 24),
+			.stored_size = pong_resources_internal_readU32(index_entry + 28)
+		};
+		if (name_offset >= names_size || payload_offset > archive_size || entry->stored_size > archive_size - payload_offset || payload_offset % PONG_PACK_ALIGNMENT)
+			PONG_ERROR("Resource data archive index is corrupt!");
+		if ((entry->method != PONG_PACK_STORED && entry->method != PONG_PACK_LZ4) || (entry->method == PONG_PACK_STORED && entry->stored_size != entry->size))
+			PONG_ERROR("Resource data archive index is corrupt!");
+		if (i && entry->hash <= previous_hash)
+			PONG_ERROR("Resource data archive index is not sorted!");
+		previous_hash = entry->hash;
+		entry->payload = archive_data + payload_offset;
+	}
+	archive_entry_count = entry_count;
+	PONG_LOG("Resource data archive holds %u resources.", PONG_LOG_VERBOSE, archive_entry_count);
+}
+
+// Binary searches the index by hash, then checks the path in case it isn't in the archive but shares a hash with one that is
+static const struct PongResourceEntry *pong_resources_internal_findEntry(const char *file_path) {
+	unsigned int hash = pong_hash_string(file_path), low = 0, high = archive_entry_count;
+	while (low < high) {
+		unsigned int middle = low + (high - low) / 2;
+		if (archive_entries[middle].hash < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low == archive_entry_count || archive_entries[low].hash != hash || strcmp(archive_entries[low].path, file_path))
+		return NULL;
+	return archive_entries + low;
+}
+
+static unsigned int pong_resources_internal_readU32(const unsigned char *bytes) {
+	return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (unsigned int) bytes[3] << 24;
+}
+
+static unsigned long long pong_resources_internal_readU64(const unsigned char *bytes) {
+	return pong_resources_internal_readU32(bytes) | (unsigned long long) pong_resources_internal_readU32(bytes + 4) << 32;
+}
+
+#ifdef PONG_RESOURCES_PROFILING
+// IDs and paths are copied, as stats outlive the resources they were taken from
+static struct PongResourceStats *pong_resources_internal_getStats(const char *file_path, const char *resource_id) {
+	struct PongResourceStats **mapped_stats = pong_hashmap_get(&resource_stats_map, resource_id);
+	if (mapped_stats)
+		return *mapped_stats;
+	struct PongResourceStats *stats = calloc(1, sizeof (struct PongResourceStats));
+	if (!stats)
+		PONG_ERROR("Could not allocate memory for resource stats!");
+	stats->resource_id = strdup(resource_id);
+	stats->file_path = strdup(file_path);
+	if (!stats->resource_id || !stats->file_path)
+		PONG_ERROR("Could not allocate memory for resource stats!");
+	mapped_stats = pong_hashmap_insert(&resource_stats_map, stats->resource_id);
+	if (!mapped_stats)
+		PONG_ERROR("Attempted to overwrite resource stats for ID '%s'!", resource_id);
+	*mapped_stats = stats;
+	return stats;
+}
+
+static void pong_resources_internal_recordLookup(struct PongCachedResource **mapped_resource) {
+	struct PongResourceStats *stats = (*mapped_resource)->stats;
+	unsigned int probe_length = pong_hashmap_getProbeLength(&resource_map, mapped_resource);
+	stats->lookup_count++;
+	stats->total_probe_length += probe_length;
+	if (probe_length > stats->max_probe_length)
+		stats->max_probe_length = probe_length;
+}
+
+// Times and sizes add up over every load, so reloads after eviction show up as the cost they are
+static void pong_resources_internal_recordLoad(struct PongResourceStats *stats, struct PongResource loaded_resource) {
+	stats->load_count++;
+	stats->find_nsec += loaded_resource.find_nsec;
+	stats->read_nsec += loaded_resource.read_nsec;
+	stats->stored_size += loaded_resource.stored_size;
+	stats->size += loaded_resource.size;
+}
+
+static int pong_resources_internal_compareStats(const void *a, const void *b) {
+	const struct PongResourceStats *a_stats = *(struct PongResourceStats *const *) a, *b_stats = *(struct PongResourceStats *const *) b;
+	unsigned long long a_nsec = a_stats->find_nsec + a_stats->read_nsec, b_nsec = b_stats->find_nsec + b_stats->read_nsec;
+	return (a_nsec < b_nsec) - (a_nsec > b_nsec);
+}
+#endif
@@ -1,10 +1,42 @@
 #ifndef PONG_RESOURCES_H
 #define PONG_RESOURCES_H
 
+#include <stddef.h>
+
+struct PongResourceRequest;
+struct PongResourceStream;
+
+#ifdef PONG_HOT_RELOAD
+typedef void (*PongResourceReloadCallback)(const char *resource_id);
+#endif
+
 void pong_resources_init(void);
 void pong_resources_load(const char *file_path, const char *resource_id);
+struct PongResourceRequest *pong_resources_loadAsync(const char *file_path, const char *resource_id);
+unsigned int pong_resources_isRequestReady(struct PongResourceRequest *request);
+void pong_resources_waitForRequest(struct PongResourceRequest *request);
+void pong_resources_loadBatch(const char *const *file_paths, const char *const *resource_ids, unsigned int count);
+struct PongResourceStream *pong_resources_openStream(const char *file_path);
+const void *pong_resources_readStream(struct PongResourceStream *stream, size_t *chunk_size);
+size_t pong_resources_getStreamSize(const struct PongResourceStream *stream);
+void pong_resources_closeStream(struct PongResourceStream *stream);
 void pong_resources_unload(const char *resource_id);
-void *pong_resources_get(const char *resource_id);
+const void *pong_resources_get(const char *resource_id);
+size_t pong_resources_getSize(const char *resource_id);
+const void *pong_resources_getHashed(unsigned int resource_hash);
+size_t pong_resources_getSizeHashed(unsigned int resource_hash);
+const void *pong_resources_acquire(const char *resource_id);
+const void *pong_resources_acquireHashed(unsigned int resource_hash);
+void pong_resources_release(const char *resource_id);
+void pong_resources_releaseHashed(unsigned int resource_hash);
+void pong_resources_setBudget(size_t budget);
+size_t pong_resources_getResidentSize(void);
+#ifdef PONG_HOT_RELOAD
+void pong_resources_addReloadCallback(PongResourceReloadCallback callback);
+void pong_resources_removeReloadCallback(PongResourceReloadCallback callback);
+void pong_resources_reloadChanged(void);
+#endif
+void pong_resources_report(void);
 void pong_resources_cleanup(void);
 
 #endif // PONG_RESOURCES_H
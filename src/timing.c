@@ -0,0 +1,198 @@
+#include "timing.h"
+#include "core.h"
+#include "files.h"
+#include "log.h"
+#include "error.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <time.h>
+
+// Histograms are log-linear like HdrHistogram: values below 2 * SUB_BUCKET_COUNT get a bucket each,
+// above that every power of two is split into SUB_BUCKET_COUNT buckets (~3% precision)
+#define PONG_TIMING_SUB_BUCKET_BITS 5
+#define PONG_TIMING_SUB_BUCKET_COUNT (1u << PONG_TIMING_SUB_BUCKET_BITS)
+#define PONG_TIMING_MAX_SHIFT 34 // values are clamped to just under 2^40 nsec
+#define PONG_TIMING_BUCKET_COUNT ((PONG_TIMING_MAX_SHIFT + 2) * PONG_TIMING_SUB_BUCKET_COUNT)
+#define PONG_TIMING_MAX_NSEC ((1ull << (PONG_TIMING_MAX_SHIFT + PONG_TIMING_SUB_BUCKET_BITS + 1)) - 1)
+#define PONG_TIMING_SAMPLE_CAPACITY 16384 // must be a power of two
+#define PONG_TIMING_CSV_FILE "timings.csv"
+
+// Each phase is only ever recorded from one thread, so counters are bumped with plain loads and stores
+// They're atomic so reports can be taken from another thread while recording carries on
+struct PongTimingHistogram {
+	atomic_uint buckets[PONG_TIMING_BUCKET_COUNT];
+	atomic_ulong count;
+	atomic_ullong max_nsec;
+	unsigned long long *samples; // last PONG_TIMING_SAMPLE_CAPACITY raw samples, for CSV dumps
+};
+
+static unsigned int pong_timing_internal_getBucketIndex(unsigned long long nsec);
+#ifdef PONG_LOGGING
+static unsigned long long pong_timing_internal_getBucketUpperBound(unsigned int index);
+static unsigned long long pong_timing_internal_getPercentile(const struct PongTimingHistogram *histogram, unsigned long count, double percentile);
+#endif
+#ifdef SIGUSR1
+static void pong_timing_internal_signalHandler(int signal_number);
+#endif
+
+static const char *phase_names[PongTimingPhaseCount] = { "tick", "update", "poll", "frame", "input", "draw", "swap" };
+static struct PongTimingHistogram histograms[PongTimingPhaseCount];
+static unsigned long long start_nsec;
+static atomic_int is_report_requested;
+
+void pong_timing_init(void) {
+	PONG_LOG_SUBGROUP_START("Timing");
+	PONG_LOG("Initializing frame timing histograms...", PONG_LOG_INFO);
+	for (unsigned int i = 0; i < PongTimingPhaseCount; i++) {
+		histograms[i].samples = calloc(PONG_TIMING_SAMPLE_CAPACITY, sizeof (unsigned long long));
+		if (!histograms[i].samples)
+			PONG_ERROR("Could not allocate memory for timing samples!");
+	}
+	start_nsec = pong_timing_getNsec();
+#ifdef SIGUSR1
+	signal(SIGUSR1, pong_timing_internal_signalHandler);
+	PONG_LOG("Send SIGUSR1 to report frame timings.", PONG_LOG_VERBOSE);
+#endif
+	PONG_LOG_SUBGROUP_END();
+}
+
+// Rates are reported over the time since this was called, so call it on entering the game loop to leave out initialization
+void pong_timing_start(void) {
+	start_nsec = pong_timing_getNsec();
+}
+
+unsigned long long pong_timing_getNsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long) now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+// Records how long the phase took since start_nsec, returning the end time so phases can be chained
+unsigned long long pong_timing_record(enum PongTimingPhase phase, unsigned long long start_nsec) {
+	unsigned long long end_nsec = pong_timing_getNsec();
+	unsigned long long nsec = end_nsec - start_nsec;
+	struct PongTimingHistogram *histogram = histograms + phase;
+	atomic_uint *bucket = histogram->buckets + pong_timing_internal_getBucketIndex(nsec);
+	atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+	if (nsec > atomic_load_explicit(&histogram->max_nsec, memory_order_relaxed))
+		atomic_store_explicit(&histogram->max_nsec, nsec, memory_order_relaxed);
+	unsigned long count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+	if (histogram->samples)
+		histogram->samples[count & (PONG_TIMING_SAMPLE_CAPACITY - 1)] = nsec;
+	atomic_store_explicit(&histogram->count, count + 1, memory_order_relaxed);
+	return end_nsec;
+}
+
+void pong_timing_requestReport(void) {
+	atomic_store(&is_report_requested, 1);
+}
+
+// Called once per loop iteration so reports requested from signal handlers get logged from a normal context
+// Returns 1 if a report was taken, so the caller can report anything else it tracks alongside it
+unsigned int pong_timing_handleReportRequest(void) {
+	if (!atomic_load_explicit(&is_report_requested, memory_order_relaxed) || !atomic_exchange(&is_report_requested, 0))
+		return 0;
+	pong_timing_report();
+	return 1;
+}
+
+void pong_timing_report(void) {
+#ifdef PONG_LOGGING
+	PONG_LOG_SUBGROUP_START("Timing");
+	double elapsed_seconds = (double) (pong_timing_getNsec() - start_nsec) / NSEC_PER_SEC;
+	PONG_LOG("Frame timings over %.1fs (p50/p95/p99/max):", PONG_LOG_INFO, elapsed_seconds);
+	for (unsigned int i = 0; i < PongTimingPhaseCount; i++) {
+		unsigned long count = atomic_load_explicit(&histograms[i].count, memory_order_relaxed);
+		if (!count)
+			continue;
+		PONG_LOG("%-6s %9lu samples (%9.1f/s) %10.1fus %10.1fus %10.1fus %10.1fus", PONG_LOG_INFO, phase_names[i], count, count / elapsed_seconds,
+			pong_timing_internal_getPercentile(histograms + i, count, 0.50) / 1e3, pong_timing_internal_getPercentile(histograms + i, count, 0.95) / 1e3,
+			pong_timing_internal_getPercentile(histograms + i, count, 0.99) / 1e3, atomic_load_explicit(&histograms[i].max_nsec, memory_order_relaxed) / 1e3);
+	}
+	PONG_LOG_SUBGROUP_END();
+#endif
+}
+
+// Writes the most recent raw samples of every phase, oldest first
+// Only call this while nothing is being recorded (e.g. after the game loop has exited)
+void pong_timing_dumpCsv(const char *file_path) {
+	PONG_LOG("Writing frame timing samples to '%s'...", PONG_LOG_INFO, file_path);
+	FILE *file = fopen(file_path, "w");
+	if (!file) {
+		PONG_LOG("Could not open '%s' for writing!", PONG_LOG_WARNING, file_path);
+		return;
+	}
+	fprintf(file, "phase,sample,nsec\n");
+	for (unsigned int i = 0; i < PongTimingPhaseCount; i++) {
+		unsigned long count = atomic_load(&histograms[i].count);
+		unsigned long first = count > PONG_TIMING_SAMPLE_CAPACITY ? count - PONG_TIMING_SAMPLE_CAPACITY : 0;
+		for (unsigned long sample = first; sample < count; sample++)
+			fprintf(file, "%s,%lu,%llu\n", phase_names[i], sample, histograms[i].samples[sample & (PONG_TIMING_SAMPLE_CAPACITY - 1)]);
+	}
+	fclose(file);
+}
+
+void pong_timing_cleanup(void) {
+	PONG_LOG_SUBGROUP_START("Timing");
+	PONG_LOG("Cleaning up frame timing...", PONG_LOG_INFO);
+	if (histograms[0].samples) {
+		pong_timing_report();
+#ifdef PONG_TIMING_CSV
+		const char *data_directory = pong_files_getDataDirectoryPath();
+		if (data_directory) {
+			char *csv_file_path = malloc(sizeof (char) * (strlen(data_directory) + strlen(PONG_TIMING_CSV_FILE) + 1));
+			if (csv_file_path) {
+				pong_timing_dumpCsv(strcat(strcpy(csv_file_path, data_directory), PONG_TIMING_CSV_FILE));
+				free(csv_file_path);
+			}
+		}
+#endif
+	}
+	for (unsigned int i = 0; i < PongTimingPhaseCount; i++) {
+		free(histograms[i].samples);
+		histograms[i].samples = NULL;
+	}
+	PONG_LOG_SUBGROUP_END();
+}
+
+static unsigned int pong_timing_internal_getBucketIndex(unsigned long long nsec) {
+	if (nsec > PONG_TIMING_MAX_NSEC)
+		nsec = PONG_TIMING_MAX_NSEC;
+	if (nsec < 2 * PONG_TIMING_SUB_BUCKET_COUNT)
+		return nsec;
+	unsigned int shift = 63 - __builtin_clzll(nsec) - PONG_TIMING_SUB_BUCKET_BITS;
+	return (shift + 1) * PONG_TIMING_SUB_BUCKET_COUNT + (unsigned int) (nsec >> shift) - PONG_TIMING_SUB_BUCKET_COUNT;
+}
+
+#ifdef PONG_LOGGING
+static unsigned long long pong_timing_internal_getBucketUpperBound(unsigned int index) {
+	if (index < 2 * PONG_TIMING_SUB_BUCKET_COUNT)
+		return index;
+	unsigned int shift = index / PONG_TIMING_SUB_BUCKET_COUNT - 1;
+	unsigned long long sub_bucket = index % PONG_TIMING_SUB_BUCKET_COUNT + PONG_TIMING_SUB_BUCKET_COUNT;
+	return ((sub_bucket + 1) << shift) - 1;
+}
+
+static unsigned long long pong_timing_internal_getPercentile(const struct PongTimingHistogram *histogram, unsigned long count, double percentile) {
+	unsigned long long max_nsec = atomic_load_explicit(&histogram->max_nsec, memory_order_relaxed);
+	unsigned long target = (unsigned long) (percentile * count + 0.5);
+	unsigned long seen = 0;
+	for (unsigned int i = 0; i < PONG_TIMING_BUCKET_COUNT; i++) {
+		seen += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+		if (seen >= target && seen) {
+			unsigned long long upper_bound = pong_timing_internal_getBucketUpperBound(i);
+			return upper_bound < max_nsec ? upper_bound : max_nsec;
+		}
+	}
+	return max_nsec;
+}
+#endif
+
+#ifdef SIGUSR1
+static void pong_timing_internal_signalHandler(int signal_number) {
+	pong_timing_requestReport();
+}
+#endif
@@ -0,0 +1,25 @@
+#ifndef PONG_TIMING_H
+#define PONG_TIMING_H
+
+enum PongTimingPhase {
+	PONG_TIMING_TICK,
+	PONG_TIMING_UPDATE,
+	PONG_TIMING_POLL,
+	PONG_TIMING_FRAME,
+	PONG_TIMING_INPUT,
+	PONG_TIMING_DRAW,
+	PONG_TIMING_SWAP,
+	PongTimingPhaseCount
+};
+
+void pong_timing_init(void);
+void pong_timing_start(void);
+unsigned long long pong_timing_getNsec(void);
+unsigned long long pong_timing_record(enum PongTimingPhase phase, unsigned long long start_nsec);
+void pong_timing_requestReport(void);
+unsigned int pong_timing_handleReportRequest(void);
+void pong_timing_report(void);
+void pong_timing_dumpCsv(const char *file_path);
+void pong_timing_cleanup(void);
+
+#endif // PONG_TIMING_H
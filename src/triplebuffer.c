@@ -0,0 +1,29 @@
+#include "triplebuffer.h"
+
+#define PONG_TRIPLEBUFFER_INDEX_MASK 3u
+#define PONG_TRIPLEBUFFER_FRESH_BIT 4u
+
+void pong_triplebuffer_init(struct PongTripleBuffer *buffer) {
+	buffer->write_index = 0;
+	atomic_init(&buffer->shared_index, 1);
+	buffer->read_index = 2;
+}
+
+unsigned int pong_triplebuffer_getWriteIndex(const struct PongTripleBuffer *buffer) {
+	return buffer->write_index;
+}
+
+// Writer side: hands over the slot just written and takes back whichever slot was shared
+void pong_triplebuffer_publish(struct PongTripleBuffer *buffer) {
+	unsigned int previous = atomic_exchange_explicit(&buffer->shared_index, buffer->write_index | PONG_TRIPLEBUFFER_FRESH_BIT, memory_order_acq_rel);
+	buffer->write_index = previous & PONG_TRIPLEBUFFER_INDEX_MASK;
+}
+
+// Reader side: swaps in the shared slot if something new was published, else keeps the current one
+unsigned int pong_triplebuffer_acquire(struct PongTripleBuffer *buffer) {
+	if (atomic_load_explicit(&buffer->shared_index, memory_order_relaxed) & PONG_TRIPLEBUFFER_FRESH_BIT) {
+		unsigned int previous = atomic_exchange_explicit(&buffer->shared_index, buffer->read_index, memory_order_acq_rel);
+		buffer->read_index = previous & PONG_TRIPLEBUFFER_INDEX_MASK;
+	}
+	return buffer->read_index;
+}
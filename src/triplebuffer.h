@@ -0,0 +1,19 @@
+#ifndef PONG_TRIPLEBUFFER_H
+#define PONG_TRIPLEBUFFER_H
+
+#include <stdatomic.h>
+
+// Hands the latest of three slots from one writer thread to one reader thread without locking
+// The writer and reader each own one slot, the third is swapped between them through shared_index
+struct PongTripleBuffer {
+	atomic_uint shared_index;
+	unsigned int write_index;
+	unsigned int read_index;
+};
+
+void pong_triplebuffer_init(struct PongTripleBuffer *buffer);
+unsigned int pong_triplebuffer_getWriteIndex(const struct PongTripleBuffer *buffer);
+void pong_triplebuffer_publish(struct PongTripleBuffer *buffer);
+unsigned int pong_triplebuffer_acquire(struct PongTripleBuffer *buffer);
+
+#endif // PONG_TRIPLEBUFFER_H
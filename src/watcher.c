@@ -0,0 +1,151 @@
+#ifdef PONG_HOT_RELOAD
+
+#include "watcher.h"
+#include "core.h"
+#include "log.h"
+#include "error.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef PONG_PLATFORM_LINUX
+#error PONG_HOT_RELOAD watches files with inotify, which is only available on Linux!
+#endif
+
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define PONG_WATCHER_EVENT_BUFFER_SIZE 4096
+#define PONG_WATCHER_PATH_BUF_SIZE 1024
+#define PONG_WATCHER_EVENT_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)
+
+// inotify only watches a single directory, so every subdirectory gets its own watch
+// Paths are relative to the root, the same form resources are loaded by
+struct PongWatchedDirectory {
+	int watch_descriptor;
+	char *path;
+};
+
+static unsigned int pong_watcher_internal_watchDirectory(const char *directory);
+
+static const char *watch_root_path;
+static int inotify_fd = -1;
+static struct PongWatchedDirectory *watched_directories;
+static unsigned int watched_directory_count;
+static _Alignas(struct inotify_event) char event_buffer[PONG_WATCHER_EVENT_BUFFER_SIZE];
+static size_t event_buffer_length;
+static size_t event_buffer_offset;
+static char changed_file_path[PONG_WATCHER_PATH_BUF_SIZE];
+
+// Watches directory under root_path and everything below it, root_path isn't copied so it must outlive the watcher
+void pong_watcher_init(const char *root_path, const char *directory) {
+	PONG_LOG_SUBGROUP_START("Watcher");
+	PONG_LOG("Initializing file watcher...", PONG_LOG_INFO);
+	watch_root_path = root_path;
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd == -1)
+		PONG_ERROR("Could not initialize inotify!");
+	if (!pong_watcher_internal_watchDirectory(directory))
+		PONG_ERROR("Could not watch '%s%s' for changes!", root_path, directory);
+	PONG_LOG("Watching %u directories under '%s%s'.", PONG_LOG_VERBOSE, watched_directory_count, root_path, directory);
+	PONG_LOG_SUBGROUP_END();
+}
+
+// Returns the path of the next file that was written to, or NULL once there are no more changes right now
+// The path is only valid until the next poll
+const char *pong_watcher_poll(void) {
+	while (1) {
+		if (event_buffer_offset >= event_buffer_length) {
+			ssize_t bytes_read = read(inotify_fd, event_buffer, PONG_WATCHER_EVENT_BUFFER_SIZE);
+			if (bytes_read <= 0)
+				return NULL;
+			event_buffer_length = bytes_read;
+			event_buffer_offset = 0;
+		}
+		const struct inotify_event *event = (const struct inotify_event *) (event_buffer + event_buffer_offset);
+		event_buffer_offset += sizeof (struct inotify_event) + event->len;
+		if (event->mask & IN_Q_OVERFLOW)
+			PONG_LOG("File watcher missed some changes, its event queue overflowed!", PONG_LOG_WARNING);
+		if (!event->len)
+			continue;
+
+		const struct PongWatchedDirectory *directory = NULL;
+		for (unsigned int i = 0; !directory && i < watched_directory_count; i++)
+			if (watched_directories[i].watch_descriptor == event->wd)
+				directory = watched_directories + i;
+		if (!directory)
+			continue;
+		if (snprintf(changed_file_path, PONG_WATCHER_PATH_BUF_SIZE, "%s/%s", directory->path, event->name) >= PONG_WATCHER_PATH_BUF_SIZE)
+			continue;
+
+		// Files are only reported once written and closed, but new directories need watching straight away
+		if (event->mask & IN_ISDIR) {
+			if (!pong_watcher_internal_watchDirectory(changed_file_path))
+				PONG_LOG("Could not watch new directory '%s' for changes!", PONG_LOG_WARNING, changed_file_path);
+			continue;
+		}
+		if (event->mask & IN_CREATE)
+			continue;
+		return changed_file_path;
+	}
+}
+
+void pong_watcher_cleanup(void) {
+	PONG_LOG_SUBGROUP_START("Watcher");
+	PONG_LOG("Cleaning up file watcher...", PONG_LOG_INFO);
+	if (inotify_fd != -1)
+		close(inotify_fd);
+	inotify_fd = -1;
+	for (unsigned int i = 0; i < watched_directory_count; i++)
+		free(watched_directories[i].path);
+	free(watched_directories);
+	watched_directories = NULL;
+	watched_directory_count = 0;
+	event_buffer_length = event_buffer_offset = 0;
+	PONG_LOG_SUBGROUP_END();
+}
+
+static unsigned int pong_watcher_internal_watchDirectory(const char *directory) {
+	char full_path[PONG_WATCHER_PATH_BUF_SIZE];
+	if (snprintf(full_path, PONG_WATCHER_PATH_BUF_SIZE, "%s%s", watch_root_path, directory) >= PONG_WATCHER_PATH_BUF_SIZE)
+		return 0;
+	int watch_descriptor = inotify_add_watch(inotify_fd, full_path, PONG_WATCHER_EVENT_MASK);
+	if (watch_descriptor == -1)
+		return 0;
+
+	PONG_LOG("Watching '%s'...", PONG_LOG_VERBOSE, directory);
+	struct PongWatchedDirectory *new_watched_directories = realloc(watched_directories, sizeof (struct PongWatchedDirectory) * (watched_directory_count + 1));
+	if (!new_watched_directories)
+		PONG_ERROR("Could not reallocate memory for watched directories!");
+	watched_directories = new_watched_directories;
+	char *path = strdup(directory);
+	if (!path)
+		PONG_ERROR("Could not allocate memory for watched directory path!");
+	watched_directories[watched_directory_count++] = (struct PongWatchedDirectory) { watch_descriptor, path };
+
+	DIR *dir = opendir(full_path);
+	if (!dir)
+		return 1;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		char subdirectory[PONG_WATCHER_PATH_BUF_SIZE];
+		struct stat entry_stat;
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		if (snprintf(subdirectory, PONG_WATCHER_PATH_BUF_SIZE, "%s/%s", directory, entry->d_name) >= PONG_WATCHER_PATH_BUF_SIZE
+			|| snprintf(full_path, PONG_WATCHER_PATH_BUF_SIZE, "%s%s", watch_root_path, subdirectory) >= PONG_WATCHER_PATH_BUF_SIZE)
+			continue;
+		if (!stat(full_path, &entry_stat) && S_ISDIR(entry_stat.st_mode))
+			pong_watcher_internal_watchDirectory(subdirectory);
+	}
+	closedir(dir);
+	return 1;
+}
+
+#else
+
+typedef int this_is_not_an_empty_translation_unit;
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef PONG_WATCHER_H
+#define PONG_WATCHER_H
+
+void pong_watcher_init(const char *root_path, const char *directory);
+const char *pong_watcher_poll(void);
+void pong_watcher_cleanup(void);
+
+#endif // PONG_WATCHER_H
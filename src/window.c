@@ -49,6 +49,7 @@ void pong_window_update(void) {
 
 void pong_window_render(void) {
 	PONG_LOG_SUBGROUP_START("WinRender");
+	pong_renderer_flush();
 	glfwSwapBuffers(window);
 	pong_renderer_clearScreen();
 	PONG_LOG_SUBGROUP_END();
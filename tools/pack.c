@@ -0,0 +1,208 @@
+// Packs resource files into data.wad, see src/pack.h for the layout
+// Usage: pack <output file> <stored suffixes, ':'-separated> <resource files...>
+// Built and run by the Makefile's setup target
+
+#include "pack.h"
+#include "hash.h"
+#include "lz4.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct PackEntry {
+	const char *path;
+	unsigned int hash;
+	unsigned int name_offset;
+	enum PongPackMethod method;
+	unsigned char *data;
+	size_t size;
+	unsigned char *payload;
+	size_t payload_size;
+	size_t payload_offset;
+};
+
+static int pack_compareEntries(const void *a, const void *b);
+static unsigned int pack_hasStoredSuffix(const char *path, const char *stored_suffixes);
+static unsigned char *pack_readFile(const char *path, size_t *size);
+static unsigned char *pack_compress(const unsigned char *data, size_t size, size_t *compressed_size);
+static void pack_writeU32(unsigned char *bytes, unsigned int value);
+static void pack_writeU64(unsigned char *bytes, unsigned long long value);
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <output file> <stored suffixes> <resource files...>\n", argv[0]);
+		return 1;
+	}
+
+	unsigned int entry_count = argc - 3;
+	struct PackEntry *entries = calloc(entry_count ? entry_count : 1, sizeof (struct PackEntry));
+	if (!entries) {
+		fprintf(stderr, "Could not allocate memory for pack entries!\n");
+		return 1;
+	}
+
+	size_t names_size = 0, total_size = 0;
+	for (unsigned int i = 0; i < entry_count; i++) {
+		struct PackEntry *entry = entries + i;
+		entry->path = argv[i + 3];
+		entry->hash = pong_hash_string(entry->path);
+		entry->data = pack_readFile(entry->path, &entry->size);
+		if (!entry->data)
+			return 1;
+		if (entry->size >= PONG_PACK_BLOCK_UNCOMPRESSED) {
+			fprintf(stderr, "'%s' is too large to pack!\n", entry->path);
+			return 1;
+		}
+		names_size += strlen(entry->path) + 1;
+		total_size += entry->size;
+
+		// Only keep the compressed payload if it saves at least an eighth, otherwise it's not worth decompressing
+		entry->method = PONG_PACK_STORED;
+		entry->payload = entry->data;
+		entry->payload_size = entry->size;
+		if (!pack_hasStoredSuffix(entry->path, argv[2])) {
+			size_t compressed_size;
+			unsigned char *compressed = pack_compress(entry->data, entry->size, &compressed_size);
+			if (!compressed)
+				return 1;
+			if (compressed_size < entry->size - entry->size / 8) {
+				entry->method = PONG_PACK_LZ4;
+				entry->payload = compressed;
+				entry->payload_size = compressed_size;
+			} else {
+				free(compressed);
+			}
+		}
+	}
+
+	qsort(entries, entry_count, sizeof (struct PackEntry), pack_compareEntries);
+	for (unsigned int i = 1; i < entry_count; i++) {
+		if (entries[i].hash == entries[i - 1].hash) {
+			fprintf(stderr, "Resource paths '%s' and '%s' have the same hash 0x%08x, rename one of them!\n", entries[i - 1].path, entries[i].path, entries[i].hash);
+			return 1;
+		}
+	}
+
+	size_t names_offset = PONG_PACK_HEADER_SIZE + (size_t) PONG_PACK_ENTRY_SIZE * entry_count;
+	size_t pack_size = names_offset + names_size, name_offset = 0;
+	for (unsigned int i = 0; i < entry_count; i++) {
+		entries[i].name_offset = name_offset;
+		name_offset += strlen(entries[i].path) + 1;
+		pack_size = (pack_size + PONG_PACK_ALIGNMENT - 1) & ~(size_t) (PONG_PACK_ALIGNMENT - 1);
+		entries[i].payload_offset = pack_size;
+		pack_size += entries[i].payload_size;
+	}
+
+	unsigned char *pack = calloc(1, pack_size);
+	if (!pack) {
+		fprintf(stderr, "Could not allocate memory for pack!\n");
+		return 1;
+	}
+	pack_writeU32(pack, PONG_PACK_MAGIC);
+	pack_writeU32(pack + 4, PONG_PACK_VERSION);
+	pack_writeU32(pack + 8, entry_count);
+	pack_writeU32(pack + 12, names_size);
+	for (unsigned int i = 0; i < entry_count; i++) {
+		unsigned char *index_entry = pack + PONG_PACK_HEADER_SIZE + (size_t) PONG_PACK_ENTRY_SIZE * i;
+		pack_writeU32(index_entry, entries[i].hash);
+		pack_writeU32(index_entry + 4, entries[i].name_offset);
+		pack_writeU32(index_entry + 8, entries[i].method);
+		pack_writeU64(index_entry + 16, entries[i].payload_offset);
+		pack_writeU32(index_entry + 24, entries[i].size);
+		pack_writeU32(index_entry + 28, entries[i].payload_size);
+		strcpy((char *) pack + names_offset + entries[i].name_offset, entries[i].path);
+		memcpy(pack + entries[i].payload_offset, entries[i].payload, entries[i].payload_size);
+	}
+
+	FILE *file = fopen(argv[1], "wb");
+	if (!file || fwrite(pack, 1, pack_size, file) != pack_size || fclose(file)) {
+		fprintf(stderr, "Could not write '%s'!\n", argv[1]);
+		return 1;
+	}
+	for (unsigned int i = 0; i < entry_count; i++)
+		printf("  %-40s %8zu -> %8zu bytes (%s)\n", entries[i].path, entries[i].size, entries[i].payload_size, entries[i].method == PONG_PACK_LZ4 ? "lz4" : "stored");
+	printf("Packed %u resources, %zu -> %zu bytes.\n", entry_count, total_size, pack_size);
+
+	for (unsigned int i = 0; i < entry_count; i++) {
+		if (entries[i].payload != entries[i].data)
+			free(entries[i].payload);
+		free(entries[i].data);
+	}
+	free(entries);
+	free(pack);
+	return 0;
+}
+
+static int pack_compareEntries(const void *a, const void *b) {
+	unsigned int a_hash = ((const struct PackEntry *) a)->hash, b_hash = ((const struct PackEntry *) b)->hash;
+	return (a_hash > b_hash) - (a_hash < b_hash);
+}
+
+static unsigned int pack_hasStoredSuffix(const char *path, const char *stored_suffixes) {
+	size_t path_length = strlen(path);
+	while (*stored_suffixes) {
+		size_t suffix_length = strcspn(stored_suffixes, ":");
+		if (suffix_length && suffix_length <= path_length && !strncmp(path + path_length - suffix_length, stored_suffixes, suffix_length))
+			return 1;
+		stored_suffixes += suffix_length;
+		if (*stored_suffixes)
+			stored_suffixes++;
+	}
+	return 0;
+}
+
+static unsigned char *pack_readFile(const char *path, size_t *size) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		fprintf(stderr, "Could not open '%s'!\n", path);
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	long file_size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	unsigned char *data = malloc(file_size > 0 ? file_size : 1);
+	if (file_size < 0 || !data || fread(data, 1, file_size, file) != (size_t) file_size) {
+		fprintf(stderr, "Could not read '%s'!\n", path);
+		fclose(file);
+		free(data);
+		return NULL;
+	}
+	fclose(file);
+	*size = file_size;
+	return data;
+}
+
+// Compresses every block on its own, so blocks can be decompressed in any order
+static unsigned char *pack_compress(const unsigned char *data, size_t size, size_t *compressed_size) {
+	size_t block_count = (size + PONG_PACK_BLOCK_SIZE - 1) / PONG_PACK_BLOCK_SIZE;
+	unsigned char *compressed = malloc(block_count * (PONG_PACK_BLOCK_HEADER_SIZE + PONG_LZ4_COMPRESS_BOUND(PONG_PACK_BLOCK_SIZE)) + 1);
+	if (!compressed) {
+		fprintf(stderr, "Could not allocate memory for compression!\n");
+		return NULL;
+	}
+	unsigned char *output = compressed;
+	for (size_t offset = 0; offset < size; offset += PONG_PACK_BLOCK_SIZE) {
+		int block_size = size - offset < PONG_PACK_BLOCK_SIZE ? size - offset : PONG_PACK_BLOCK_SIZE;
+		int stored_size = pong_lz4_compress(data + offset, block_size, output + PONG_PACK_BLOCK_HEADER_SIZE, block_size - 1);
+		if (stored_size) {
+			pack_writeU32(output, stored_size);
+		} else {
+			stored_size = block_size;
+			memcpy(output + PONG_PACK_BLOCK_HEADER_SIZE, data + offset, block_size);
+			pack_writeU32(output, block_size | PONG_PACK_BLOCK_UNCOMPRESSED);
+		}
+		output += PONG_PACK_BLOCK_HEADER_SIZE + stored_size;
+	}
+	*compressed_size = output - compressed;
+	return compressed;
+}
+
+static void pack_writeU32(unsigned char *bytes, unsigned int value) {
+	for (unsigned int i = 0; i < 4; i++)
+		bytes[i] = value >> (i * 8);
+}
+
+static void pack_writeU64(unsigned char *bytes, unsigned long long value) {
+	for (unsigned int i = 0; i < 8; i++)
+		bytes[i] = value >> (i * 8);
+}
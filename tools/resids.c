@@ -0,0 +1,94 @@
+// Generates a header of resource IDs hashed ahead of time, so the game never has to hash their paths at runtime
+// Usage: resids <output header> <resource files...>
+// Built and run by the Makefile's setup target
+
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define RESIDS_PATH_PREFIX "res/"
+#define RESIDS_HASH_SUFFIX "_HASH"
+
+static char *resids_makeName(const char *path);
+static unsigned int resids_isHashName(const char *name, const char *other_name);
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <output header> <resource files...>\n", argv[0]);
+		return 1;
+	}
+
+	unsigned int path_count = argc - 2;
+	char **paths = argv + 2;
+	unsigned int *hashes = malloc(sizeof (unsigned int) * (path_count ? path_count : 1));
+	char **names = calloc(path_count ? path_count : 1, sizeof (char *));
+	if (!hashes || !names) {
+		fprintf(stderr, "Could not allocate memory for resource hashes and names!\n");
+		return 1;
+	}
+
+	// Hashes must be unique for lookups by hash alone to be safe, and names so the generated macros don't clash
+	for (unsigned int i = 0; i < path_count; i++) {
+		hashes[i] = pong_hash_string(paths[i]);
+		names[i] = resids_makeName(paths[i]);
+		if (!names[i]) {
+			fprintf(stderr, "Could not allocate memory for resource name!\n");
+			return 1;
+		}
+		for (unsigned int j = 0; j < i; j++) {
+			if (hashes[i] == hashes[j]) {
+				fprintf(stderr, "Resource paths '%s' and '%s' have the same hash 0x%08x, rename one of them!\n", paths[j], paths[i], hashes[i]);
+				return 1;
+			}
+			if (!strcmp(names[i], names[j]) || resids_isHashName(names[i], names[j]) || resids_isHashName(names[j], names[i])) {
+				fprintf(stderr, "Resource paths '%s' and '%s' have clashing names PONG_RESOURCE_%s and PONG_RESOURCE_%s, rename one of them!\n", paths[j], paths[i], names[j], names[i]);
+				return 1;
+			}
+		}
+	}
+
+	FILE *header = fopen(argv[1], "w");
+	if (!header) {
+		fprintf(stderr, "Could not open '%s' for writing!\n", argv[1]);
+		return 1;
+	}
+	fprintf(header, "// Generated by tools/resids.c from the files in res/, do not edit\n\n");
+	fprintf(header, "#ifndef PONG_RESOURCE_IDS_H\n#define PONG_RESOURCE_IDS_H\n\n");
+	for (unsigned int i = 0; i < path_count; i++) {
+		fprintf(header, "#define PONG_RESOURCE_%s \"%s\"\n", names[i], paths[i]);
+		fprintf(header, "#define PONG_RESOURCE_%s" RESIDS_HASH_SUFFIX " 0x%08xu\n", names[i], hashes[i]);
+	}
+	fprintf(header, "\n#endif // PONG_RESOURCE_IDS_H\n");
+
+	for (unsigned int i = 0; i < path_count; i++)
+		free(names[i]);
+	free(names);
+	free(hashes);
+	if (fclose(header)) {
+		fprintf(stderr, "Could not write '%s'!\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+// Drops the res/ prefix and uppercases the rest, with anything that can't be in a macro name becoming an underscore
+static char *resids_makeName(const char *path) {
+	if (!strncmp(path, RESIDS_PATH_PREFIX, strlen(RESIDS_PATH_PREFIX)))
+		path += strlen(RESIDS_PATH_PREFIX);
+	char *name = malloc(sizeof (char) * (strlen(path) + 1));
+	if (!name)
+		return NULL;
+	char *name_char = name;
+	for (const char *path_char = path; *path_char; path_char++)
+		*name_char++ = isalnum((unsigned char) *path_char) ? toupper((unsigned char) *path_char) : '_';
+	*name_char = '\0';
+	return name;
+}
+
+// Returns 1 if name is other_name's hash macro name, e.g. res/a_hash would clash with res/a's hash
+static unsigned int resids_isHashName(const char *name, const char *other_name) {
+	size_t other_name_len = strlen(other_name);
+	return !strncmp(name, other_name, other_name_len) && !strcmp(name + other_name_len, RESIDS_HASH_SUFFIX);
+}